@@ -4,60 +4,121 @@
     #include <mmsystem.h>
     // #pragma comment(lib,"winmm.lib")
     #include <conio.h>
+    #include <atomic>
+
+    std::atomic<bool> inputWoken(false);
+
+    void enableRawMode() {} // The console already hands keys to _getch unbuffered and unechoed
+    void disableRawMode() {}
+
+    int readKeys(char* keys, int size, int timeout) {
+        // Waits up to timeout milliseconds for keys, returns how many were read (0 on timeout or wakeup)
+        for (int waited = 0; !_kbhit(); waited += 5) {
+            if (inputWoken || waited >= timeout) return 0;
+            Sleep(5);
+        }
+        int count = 0;
+        while (count < size && _kbhit()) {
+            keys[count++] = (char)_getch();
+        }
+        return count;
+    }
+
+    void wakeInput() {
+        inputWoken = true;
+    }
+
+    bool terminalSize(int& rows, int& columns) {
+        // Leaves rows and columns untouched when there is no console
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) return false;
+        rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        columns = info.srWindow.Right - info.srWindow.Left + 1;
+        return true;
+    }
 
     void flushInput() {
         // Flush the input buffer (discard data not read yet)
         HANDLE hInput = GetStdHandle(STD_INPUT_HANDLE);
         FlushConsoleInputBuffer(hInput);
     }
-#elif __APPLE__
+#elif __APPLE__ or __linux__
     #include <termios.h>
     #include <unistd.h>
+    #include <poll.h>
+    #include <sys/ioctl.h>
 
     struct termios orig_termios;
-    void term_echooff() {
-        struct termios noecho;
+    bool rawMode = false;
+    int wakeupPipe[2] = {-1, -1}; // Written to by wakeInput() so a blocked readKeys() returns at once
 
-        tcgetattr(0, &orig_termios);
+    void enableRawMode() {
+        // Switches the terminal to unbuffered, unechoed input once for the whole game
+        if (rawMode) return;
+        if (tcgetattr(STDIN_FILENO, &orig_termios) < 0) {
+            perror("tcgetattr()");
+            return;
+        }
+        struct termios raw = orig_termios;
+        raw.c_lflag &= ~(ECHO | ICANON);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) < 0) {
+            perror("tcsetattr()");
+            return;
+        }
+        rawMode = true;
+        if (wakeupPipe[0] < 0 && pipe(wakeupPipe) < 0) {
+            perror("pipe()");
+        }
+    }
 
-        noecho = orig_termios;
-        noecho.c_lflag &= ~(ECHO | ICANON);
+    void disableRawMode() {
+        if (!rawMode) return;
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &orig_termios);
+        rawMode = false;
+    }
 
-        tcsetattr(0, TCSANOW, &noecho);
+    char getch() {
+        // Blocking read of a single key, relies on enableRawMode() having been called
+        char key = 0;
+        if (read(STDIN_FILENO, &key, 1) < 0)
+            perror("read()");
+        return key;
     }
 
-    void flushInput() {
-        // Flush stdin (discard data not read yet)
-        tcflush(STDIN_FILENO, TCIFLUSH);
+    int readKeys(char* keys, int size, int timeout) {
+        // Waits up to timeout milliseconds for keys, returns how many were read (0 on timeout or wakeup, -1 on EOF)
+        struct pollfd fds[2] = {
+            {STDIN_FILENO, POLLIN, 0},
+            {wakeupPipe[0], POLLIN, 0}
+        };
+        int ready = poll(fds, wakeupPipe[0] < 0 ? 1 : 2, timeout);
+        if (ready <= 0) return 0;
+        if (fds[1].revents & POLLIN) return 0;
+        if (!(fds[0].revents & (POLLIN | POLLHUP))) return 0;
+        ssize_t count = read(STDIN_FILENO, keys, size);
+        return count > 0 ? (int)count : -1;
     }
-#elif __linux__    
-    #include <unistd.h>
-    #include <termios.h>
 
-    char getch(void) {
-        char buf = 0;
-        struct termios old = {0};
-        fflush(stdout);
-        if(tcgetattr(0, &old) < 0)
-            perror("tcsetattr()");
-        old.c_lflag &= ~ICANON;
-        old.c_lflag &= ~ECHO;
-        old.c_cc[VMIN] = 1;
-        old.c_cc[VTIME] = 0;
-        if(tcsetattr(0, TCSANOW, &old) < 0)
-            perror("tcsetattr ICANON");
-        if(read(0, &buf, 1) < 0)
-            perror("read()");
-        old.c_lflag |= ICANON;
-        old.c_lflag |= ECHO;
-        if(tcsetattr(0, TCSADRAIN, &old) < 0)
-            perror("tcsetattr ~ICANON");
-        // printf("%c\n", buf);
-        return buf;
+    void wakeInput() {
+        if (wakeupPipe[1] < 0) return;
+        char byte = 0;
+        if (write(wakeupPipe[1], &byte, 1) < 0)
+            perror("write()");
+    }
+
+    bool terminalSize(int& rows, int& columns) {
+        // Leaves rows and columns untouched when stdout is not a terminal
+        struct winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) < 0 || size.ws_row == 0) return false;
+        rows = size.ws_row;
+        columns = size.ws_col;
+        return true;
     }
 
     void flushInput() {
         // Flush stdin (discard data not read yet)
         tcflush(STDIN_FILENO, TCIFLUSH);
     }
-#endif
\ No newline at end of file
+#endif
@@ -1,22 +1,48 @@
 #include "cross_platform.hpp"
 #include "inomhus.hpp"
+#include "queue.hpp"
+#include "workers.hpp"
 #include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cerrno>
 #include <thread>
+#include <atomic>
 #include <chrono>
-#include <mutex>
+#include <cstdlib>
+#include <new>
+#include <memory_resource>
+#include <unordered_set>
 
 #define DAY_DURATION 700
 #define NIGHT_DURATION 200
 
-#define WIDTH 70
+#define WIDTH 70 // Default size of the world, also the largest viewport and the smallest world
 #define HEIGHT 30
+#define MAX_WORLD_SIZE 4096 // Per side, --width and --height are clamped to it
+#define PARALLEL_MOBS 1024 // Fewer inner mobs than this are updated on the main thread, waking the workers would cost more
+#define MAX_THREADS 64 // For --threads, more than the regions of the world are never started
+#define SIDE_PANEL_WIDTH 50 // Columns kept free on the right of the viewport
+#define GENERATION_RADIUS 2 // Chunks generated around the one of the player in every direction, enough to fill the viewport
 
 #define VERSION "1.0.1"
 #define DATE "2025-12-16"
 
+#define HEADLESS_TICKS 100000 // Default number of ticks simulated by --headless
+#define TICKS_PER_SECOND 10.0 // Default tick rate, DAY_DURATION and NIGHT_DURATION are in ticks
+#define MAX_TICKS_PER_SECOND 1000.0 // --tps is clamped to it, the period of a tick must not round to zero
+#define SPEEDUP_FACTOR 4 // How much faster ticks are in speedup mode
+#define MAX_CATCH_UP 50 // Ticks behind after which CATCH_UP gives up and starts again from now
+#define CATCH_UP_FRAMES 5 // While catching up a frame is still drawn every this many ticks, so the screen does not freeze
+
+#define RESYNC_PERIOD 600 // Ticks between two full reprints of the field
+#define FRAME_CAPACITY 16384 // Bytes preallocated for the output of a frame, a full reprint may grow it
+#define INPUT_BATCH 64 // Keys read from the terminal with a single syscall
+#define INPUT_QUEUE_SIZE 256 // Keys buffered between the input thread and the main loop, a power of two
+#define INPUT_TIMEOUT 100 // Milliseconds the input thread waits before checking whether the game ended
+#define ARENA_SIZE (1 << 20) // Bytes of scratch memory for the containers of a tick, a busier tick takes more from the heap
+
 #define REPOPULATE 0
 #define DEBUG 0
 #if DEBUG
@@ -24,19 +50,19 @@
 #endif
 
 std::shared_ptr<Player> Player::player;
-std::vector<std::shared_ptr<Walker>> Walker::walkers;
-std::vector<std::shared_ptr<Archer>> Archer::archers;
-std::vector<std::shared_ptr<Bullet>> Bullet::bullets;
-std::vector<std::shared_ptr<EnemyBullet>> EnemyBullet::enemyBullets;
-std::vector<std::shared_ptr<Mine>> Mine::mines;
-std::vector<std::shared_ptr<Chest>> Chest::chests;
-std::vector<std::shared_ptr<Trap>> Trap::traps;
-std::vector<std::shared_ptr<Weasel>> Weasel::weasels;
-std::vector<std::shared_ptr<Snake>> Snake::snakes;
-std::vector<std::shared_ptr<Chicken>> Chicken::chickens;
-std::vector<std::shared_ptr<Egg>> Egg::eggs;
-std::vector<std::shared_ptr<Gate>> Gate::gates;
-std::vector<std::shared_ptr<Wall>> Wall::walls;
+SlotMap<Walker> Walker::walkers;
+SlotMap<Archer> Archer::archers;
+SlotMap<Bullet> Bullet::bullets;
+SlotMap<EnemyBullet> EnemyBullet::enemyBullets;
+SlotMap<Mine> Mine::mines;
+SlotMap<Chest> Chest::chests;
+SlotMap<Trap> Trap::traps;
+SlotMap<Weasel> Weasel::weasels;
+SlotMap<Snake> Snake::snakes;
+SlotMap<Chicken> Chicken::chickens;
+SlotMap<Egg> Egg::eggs;
+SlotMap<Gate> Gate::gates;
+SlotMap<Wall> Wall::walls;
 
 std::bernoulli_distribution Egg::hatchingDistribution(0.26); // 26%
 std::bernoulli_distribution eggSelfHatchingDistribution(0.001); // 0.1%
@@ -72,7 +98,7 @@ std::vector<char> acceptedKeys = {
     '+', '-', '.', 'p', 'P', 'Q'
 };
 
-sista::SwappableField* field;
+World* field;
 sista::Cursor cursor;
 sista::Border border(
     '@', {
@@ -81,364 +107,536 @@ sista::Border border(
         sista::Attribute::BRIGHT
     }
 );
-std::mutex streamMutex;
 bool tutorial_ = true;
 bool speedup = false;
 bool pause_ = false;
-bool end = false;
+std::atomic<bool> end(false); // Also read by the input thread
 bool day = true;
+bool headless = false; // No terminal, no input thread and no sleeping, just ticks
+bool fullRedraw = false; // Set by tick() when the whole field has to be reprinted
+Replay replay;
+const char* savePath = nullptr; // Written by --save at the end of the game, and by 'x' during it
+const char* saveStatus = ""; // Shown in the side panel after 'x'
+SpscQueue<char, INPUT_QUEUE_SIZE> keyQueue; // Keys pushed by the input thread, drained by the main loop before each tick
+std::string deathMessage; // Why the game ended, printed once the field is drawn for the last time
+uint32_t nextSwitch = DAY_DURATION - 1; // Tick during which the day or the night ends
+int worldWidth = WIDTH;
+int worldHeight = HEIGHT;
+int viewWidth = WIDTH; // Cells of the world visible at once, never more than the world
+int viewHeight = HEIGHT;
+thread_local Region* region = nullptr;
+std::vector<Region> regions; // One per REGION_HEIGHT rows of the world
+WorkerPool workers; // Updates the regions, main thread included
+FlowField flowField; // Toward the player, updated before the walkers move
+TimerWheel<Timer, TIMER_BUCKETS> timers; // Eggs hatching by themselves and archers shooting
+TimerWheel<std::function<void()>, TIMER_BUCKETS> events;
+uint32_t currentTick = 0;
+alignas(std::max_align_t) unsigned char arenaBuffer[ARENA_SIZE];
+std::pmr::monotonic_buffer_resource tickArena(arenaBuffer, ARENA_SIZE); // Scratch containers of the tick, released at its end
+std::atomic<uint64_t> allocations(0); // Calls to operator new, from any thread
+uint64_t tickAllocations = 0; // Made during the last tick, shown in the side panel and summed by --headless
+std::vector<std::pair<uint32_t, std::function<void()>>> periodic; // Period and callback of every event from every()
+
+
+// Counted, so that the side panel and --headless can show that a tick allocates nothing once the game is running
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+        if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
 
 
 int main(int argc, char** argv) {
-    #ifdef __APPLE__
-        term_echooff();
-        // system("stty raw -echo");
-    #endif
     std::ios_base::sync_with_stdio(false);
-    sista::resetAnsi(); // Reset the settings
-    srand(time(0)); // Seed the random number generator
 
+    int ticks = HEADLESS_TICKS;
+    uint64_t seed = std::random_device{}() ^ (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+    double tps = TICKS_PER_SECOND;
+    Scheduler::Policy policy = Scheduler::Policy::CATCH_UP;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* loadPath = nullptr;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
     if (argc > 1) {
         for (int i=1; i<argc; i++) {
             if (strcmp(argv[i], "--no-tutorial") == 0 || strcmp(argv[i], "-n") == 0) {
                 tutorial_ = false;
+            } else if (strcmp(argv[i], "--headless") == 0) {
+                headless = true;
+            } else if ((strcmp(argv[i], "--ticks") == 0 || strcmp(argv[i], "-t") == 0) && i+1 < argc) {
+                ticks = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--tps") == 0 && i+1 < argc) {
+                tps = atof(argv[++i]);
+                if (!(tps > 0)) tps = TICKS_PER_SECOND; // Also nan
+                tps = std::min(tps, MAX_TICKS_PER_SECOND);
+            } else if (strcmp(argv[i], "--skip") == 0) {
+                policy = Scheduler::Policy::SKIP;
+            } else if (strcmp(argv[i], "--catch-up") == 0) {
+                policy = Scheduler::Policy::CATCH_UP;
+            } else if (strcmp(argv[i], "--seed") == 0 && i+1 < argc) {
+                seed = strtoull(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+                recordPath = argv[++i];
+            } else if (strcmp(argv[i], "--replay") == 0 && i+1 < argc) {
+                replayPath = argv[++i];
+            } else if (strcmp(argv[i], "--save") == 0 && i+1 < argc) {
+                savePath = argv[++i];
+            } else if (strcmp(argv[i], "--load") == 0 && i+1 < argc) {
+                loadPath = argv[++i];
+            } else if (strcmp(argv[i], "--width") == 0 && i+1 < argc) {
+                worldWidth = std::clamp(atoi(argv[++i]), WIDTH, MAX_WORLD_SIZE);
+            } else if (strcmp(argv[i], "--height") == 0 && i+1 < argc) {
+                worldHeight = std::clamp(atoi(argv[++i]), HEIGHT, MAX_WORLD_SIZE);
+            } else if ((strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "-j") == 0) && i+1 < argc) {
+                threads = std::clamp(atoi(argv[++i]), 1, MAX_THREADS);
             }
         }
     }
 
-    sista::SwappableField field_(WIDTH, HEIGHT);
-    field = &field_;
-    field->clear();
-    printIntro();
-    #if defined(_WIN32) or defined(__linux__)
-        char c = getch();
-    #elif __APPLE__
-        char c = getchar();
-    #endif
-    if (c == 'n' || c == 'N') {
+    if (replayPath != nullptr) {
+        if (!replay.load(replayPath)) {
+            std::cerr << "Could not read the replay " << replayPath << '\n';
+            return 1;
+        }
+        seed = replay.seed;
+        worldWidth = std::clamp(replay.width, WIDTH, MAX_WORLD_SIZE);
+        worldHeight = std::clamp(replay.height, HEIGHT, MAX_WORLD_SIZE);
+        tutorial_ = false; // The tutorial is not part of the recording
+    } else if (recordPath != nullptr) {
+        if (!replay.start(recordPath, seed)) {
+            std::cerr << "Could not write the replay " << recordPath << '\n';
+            return 1;
+        }
         tutorial_ = false;
     }
-    sista::clearScreen();
-
-    if (tutorial_) {
-        tutorial();
-    } else {
-        field->addPrintPawn(Player::player = std::make_shared<Player>(sista::Coordinates{0, 0}));
+    if (loadPath != nullptr && !readSnapshotSize(loadPath, worldWidth, worldHeight)) {
+        std::cerr << "Could not load the snapshot " << loadPath << '\n';
+        return 1;
+    }
+    rng.reseed(seed);
+    bool lazy = worldWidth > WIDTH || worldHeight > HEIGHT;
+    World field_(worldWidth, worldHeight, lazy);
+    field = &field_;
+    regions.resize((worldHeight + REGION_HEIGHT - 1) / REGION_HEIGHT);
+    workers.start(std::min<unsigned>(threads, regions.size()));
+    if (lazy) {
+        tutorial_ = false; // The tutorial is laid out on the default world, which is populated at once
+    }
+    uint32_t firstTick = 0;
+    if (loadPath != nullptr) {
+        NullBuffer nullBuffer; // The renderer will draw the loaded world from scratch
+        std::streambuf* terminal = std::cout.rdbuf(&nullBuffer);
+        bool loaded = loadGame(loadPath, firstTick);
+        std::cout.rdbuf(terminal);
+        if (!loaded) {
+            std::cerr << "Could not load the snapshot " << loadPath << '\n';
+            return 1;
+        }
+    }
+    scheduleEvents();
+    if (headless) {
+        return runHeadless(ticks, firstTick);
     }
 
-    populate(field);
-    sista::clearScreen();
-    field->print(border);
+    int rows = HEIGHT + 2, columns = WIDTH + 2 + SIDE_PANEL_WIDTH;
+    terminalSize(rows, columns);
+    viewHeight = std::min(worldHeight, std::clamp(rows - 2, 10, HEIGHT));
+    viewWidth = std::min(worldWidth, std::clamp(columns - 2 - SIDE_PANEL_WIDTH, 20, WIDTH));
 
-    std::thread th(input);
-    int dayCountdown = NIGHT_DURATION;
-    int nightCountdown = DAY_DURATION;
-    for (int i=0; !end; i++) {
-        while (pause_) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            if (end) break;
-        }
-        if (speedup) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(25));
-        } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    enableRawMode();
+    sista::resetAnsi(); // Reset the settings
+    if (loadPath == nullptr) {
+        printIntro();
+        char c = getch();
+        if (c == 'n' || c == 'N') {
+            tutorial_ = false;
         }
+        sista::clearScreen();
 
-        if (day) {
-            nightCountdown--;
+        if (tutorial_) {
+            tutorial();
         } else {
-            dayCountdown--;
-            // Implement lycanthropy for the user, randomly picking a game key
-            char key = gameKeys[rand() % gameKeys.size()];
-            act(key);
-        } // This could be golfed lol, but it's clearer this way
-        if (dayCountdown <= 0 || nightCountdown <= 0) {
-            day = !day;
-            dayCountdown = NIGHT_DURATION;
-            nightCountdown = DAY_DURATION;
-            if (day) {
-                // The day is back, but the out-of-control player destroys the inventory
-                Player::player->inventory = Inventory{0, 0, 0};
-                Player::player->setSettings(Player::playerStyle);
-                border = sista::Border(
-                    '@', {
-                        sista::ForegroundColor::BLACK,
-                        sista::BackgroundColor::WHITE,
-                        sista::Attribute::BRIGHT
-                    }
-                );
-            } else {
-                // The player is now out of control
-                Player::player->setSettings(nightPlayerStyle);
-                border = sista::Border(
-                    '@', {
-                        sista::ForegroundColor::WHITE,
-                        sista::BackgroundColor::BLACK,
-                        sista::Attribute::BRIGHT
-                    }
-                );
-            }
-            sista::clearScreen();
-            field->print(border);
-        }
-        std::vector<sista::Coordinates> coordinates;
-        for (unsigned short j=0; j<HEIGHT; j++) {
-            for (unsigned short i=0; i<WIDTH; i++) {
-                Entity* pawn = (Entity*)field->getPawn(j, i);
-                if (pawn == nullptr) continue;
-                auto not_in = [&](const auto &vec) {
-                    return std::find_if(vec.begin(), vec.end(),
-                        [pawn](const std::shared_ptr<Entity> &e){ return e.get() == pawn; }
-                    ) == vec.end();
-                };
-                if (not_in(Bullet::bullets) &&
-                    not_in(EnemyBullet::enemyBullets) &&
-                    not_in(Archer::archers) &&
-                    not_in(Walker::walkers) &&
-                    not_in(Wall::walls) &&
-                    not_in(Mine::mines) &&
-                    not_in(Gate::gates) &&
-                    not_in(Weasel::weasels) &&
-                    not_in(Snake::snakes) &&
-                    not_in(Chicken::chickens) &&
-                    not_in(Egg::eggs) &&
-                    not_in(Chest::chests) &&
-                    not_in(Trap::traps) &&
-                    pawn != Player::player.get()) {
-                    coordinates.push_back(pawn->getCoordinates());
-                    #if DEBUG
-                    debug << "Erasing " << pawn << " at {" << j << ", " << i << "}" << std::endl;
-                    debug << "\t" << typeid(*pawn).name() << std::endl;
-                    #endif
-                }
-            }
-        }
-        // for (auto coord : coordinates) {
-        //     field->erasePawn(field->getPawn(coord));
-        // }
-        std::lock_guard<std::mutex> lock(streamMutex);
-        for (unsigned j=0; j<Bullet::bullets.size(); j++) {
-            if (j >= Bullet::bullets.size()) break;
-            Bullet* bullet = Bullet::bullets[j].get();
-            if (bullet == nullptr) continue;
-            if (bullet->collided) continue;
-            bullet->move();
-        }
-        EnemyBullet::enemyBullets.erase(
-            std::remove_if(
-                EnemyBullet::enemyBullets.begin(),
-                EnemyBullet::enemyBullets.end(),
-                [](const std::shared_ptr<EnemyBullet>& enemyBullet) {
-                    if (!enemyBullet) return true;
-                    if (enemyBullet->collided) {
-                        // Remove pawn from field before erasing
-                        field->erasePawn(enemyBullet.get());
-                        return true;
-                    }
-                    return false;
-                }
-            ),
-            EnemyBullet::enemyBullets.end()
-        );
-        Bullet::bullets.erase(
-            std::remove_if(
-                Bullet::bullets.begin(),
-                Bullet::bullets.end(),
-                [](const std::shared_ptr<Bullet>& bullet) {
-                    if (!bullet) return true;
-                    if (bullet->collided) {
-                        // Remove pawn from field before erasing
-                        field->erasePawn(bullet.get());
-                        return true;
-                    }
-                    return false;
-                }
-            ),
-            Bullet::bullets.end()
-        );
-        for (unsigned j=0; j<EnemyBullet::enemyBullets.size(); j++) {
-            if (j >= EnemyBullet::enemyBullets.size()) break;
-            EnemyBullet* enemyBullet = EnemyBullet::enemyBullets[j].get();
-            if (enemyBullet == nullptr) continue;
-            if (enemyBullet->collided) continue;
-            enemyBullet->move();
-        }
-        EnemyBullet::enemyBullets.erase(
-            std::remove_if(
-                EnemyBullet::enemyBullets.begin(),
-                EnemyBullet::enemyBullets.end(),
-                [](const std::shared_ptr<EnemyBullet>& enemyBullet) {
-                    if (!enemyBullet) return true;
-                    if (enemyBullet->collided) {
-                        // Remove pawn from field before erasing
-                        field->erasePawn(enemyBullet.get());
-                        return true;
-                    }
-                    return false;
-                }
-            ),
-            EnemyBullet::enemyBullets.end()
-        );
-        Bullet::bullets.erase(
-            std::remove_if(
-                Bullet::bullets.begin(),
-                Bullet::bullets.end(),
-                [](const std::shared_ptr<Bullet>& bullet) {
-                    if (!bullet) return true;
-                    if (bullet->collided) {
-                        // Remove pawn from field before erasing
-                        field->erasePawn(bullet.get());
-                        return true;
-                    }
-                    return false;
-                }
-            ),
-            Bullet::bullets.end()
-        );
-        for (auto mine : Mine::mines) {
-            if (mine->triggered) {
-                mine->explode();
-                mine->alive = false;
-            }
-        }
-        for (auto mine : Mine::mines) {
-            if (!mine->alive) {
-                Mine::removeMine(mine.get());
-            } else {
-                mine->checkTrigger();
-            }
-        }
-        for (unsigned c=0; c<Chest::chests.size(); c++) {
-            if (c >= Chest::chests.size()) break;
-            Chest* chest = Chest::chests[c].get();
-            if (chest == nullptr) continue;
-            if (chest->inventory.walls == 0 && chest->inventory.eggs == 0 && chest->inventory.meat == 0) {
-                Chest::removeChest(chest);
-            }
-        }
-        for (unsigned c=0; c<Chicken::chickens.size(); c++) {
-            if (c >= Chicken::chickens.size()) break;
-            Chicken* chicken = Chicken::chickens[c].get();
-            if (chicken == nullptr) continue;
-            if (Chicken::movingDistribution(rng)) {
-                chicken->move();
-            }
-        }
-        // Eggs self-hatching
-        for (unsigned e=0; e<Egg::eggs.size(); e++) {
-            if (e >= Egg::eggs.size()) break;
-            Egg* egg = Egg::eggs[e].get();
-            if (egg == nullptr) continue;
-            if (eggSelfHatchingDistribution(rng)) {
-                if (Egg::hatchingDistribution(rng)) {
-                    sista::Coordinates coords = egg->getCoordinates();
-                    Egg::removeEgg(egg);
-                    Chicken::chickens.push_back(std::make_shared<Chicken>(coords));
-                    field->addPrintPawn(Chicken::chickens.back());
-                } else {
-                    Egg::removeEgg(egg);
-                }
-            }
+            generateAround(field, {0, 0});
+            field->addPrintPawn(Player::player = std::make_shared<Player>(sista::Coordinates{0, 0}));
         }
-        for (unsigned w=0; w<Walker::walkers.size(); w++) {
-            if (w >= Walker::walkers.size()) break;
-            Walker* walker = Walker::walkers[w].get();
-            if (walker == nullptr) continue;
-            if (Walker::movingDistribution(rng)) {
-                walker->move();
+    }
+
+    Renderer renderer(viewWidth, viewHeight);
+    renderer.mute();
+    field->printing = false; // The renderer draws from the world itself, from now on
+    if (loadPath == nullptr && !field->lazy) {
+        populate(field);
+    }
+    renderer.unmute();
+    renderer.resync();
+    printInstructions();
+    renderer.send();
+    renderer.mute(); // From now on Sista's output is replaced by the diffs of present()
+
+    std::thread th(input);
+    Scheduler scheduler(tps, policy);
+    uint32_t i = firstTick;
+    int undrawn = 0; // Late ticks run since the last frame
+    for (; !end; i++) {
+        if (pause_) {
+            while (pause_ && !end) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                drainKeys(i, true);
             }
+            scheduler.reset(); // The time spent paused is not a delay to catch up with
+            if (end) break;
         }
-        for (unsigned a=0; a<Archer::archers.size(); a++) {
-            if (a >= Archer::archers.size()) break;
-            Archer* archer = Archer::archers[a].get();
+        scheduler.setRate(speedup ? tps * SPEEDUP_FACTOR : tps);
+        scheduler.wait();
+
+        drainKeys(i, replay.mode == Replay::Mode::PLAY && !replay.finished()); // The player takes over when the replay is over
+        replay.feed(i);
+        if (end) break;
+        tick(i);
+        if (scheduler.late && ++undrawn < CATCH_UP_FRAMES) continue; // Catching up, drawing every frame would only fall further behind
+        undrawn = 0;
+
+        renderer.follow(Player::player->getCoordinates());
+        renderer.unmute();
+        if (fullRedraw) {
+            // Rarely reprint everything, in case the terminal got out of sync, and when day or night begins
+            renderer.resync();
+            printInstructions();
+            fullRedraw = false;
+        }
+        renderer.present();
+
+        // Print inventory and time
+        printSideInstructions(i, nextSwitch - i);
+        cursor.goTo(12, viewWidth+10);
+        std::cout << "Frame: " << renderer.frame.bytes << " bytes, " << renderer.frame.writes << " writes, " << tickAllocations << " allocations    ";
+        cursor.goTo(13, viewWidth+10);
+        std::cout << "Late ticks: " << scheduler.missed << ", " << scheduler.skipped << " skipped (worst " << scheduler.worstLateness.count() / 1000000 << " ms)    ";
+        cursor.goTo(8, viewWidth+10);
+        std::cout << saveStatus;
+        cursor.goTo(9, viewWidth+10);
+        std::cout << "Seed: " << rng.seed;
+        renderer.send();
+        renderer.mute();
+    }
+
+    wakeInput(); // The input thread may be waiting for a key that will never come
+    th.join();
+    if (savePath != nullptr && deathMessage.empty()) {
+        saveGame(savePath, i);
+    }
+    renderer.unmute();
+    renderer.present();
+    if (!deathMessage.empty()) {
+        sista::resetAnsi();
+        cursor.goTo(viewHeight, viewWidth+10);
+        sista::setAttribute(sista::Attribute::BLINK);
+        sista::setBackgroundColor(sista::BackgroundColor::RED);
+        sista::setForegroundColor(sista::ForegroundColor::BLACK);
+        std::cout << deathMessage;
+        sista::resetAnsi();
+    }
+    renderer.send();
+    renderer.restore();
+    field->clear();
+    cursor.goTo(72, 0); // Move the cursor to the bottom of the screen, so the terminal is not left in a weird state
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    flushInput();
+    getch();
+    disableRawMode();
+}
+
+int runHeadless(int ticks, uint32_t firstTick) {
+    // Everything Sista prints goes to the null buffer, there is no terminal to draw on
+    NullBuffer nullBuffer;
+    std::streambuf* terminal = std::cout.rdbuf(&nullBuffer);
+
+    field->printing = false;
+    if (Player::player == nullptr) { // Nothing was loaded
+        generateAround(field, {0, 0});
+        field->addPrintPawn(Player::player = std::make_shared<Player>(sista::Coordinates{0, 0}));
+        if (!field->lazy) {
+            populate(field);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t i = firstTick;
+    uint64_t allocated = 0;
+    uint32_t quiet = 0; // Ticks without a single allocation
+    for (; !end && i - firstTick < (uint32_t)ticks; i++) {
+        replay.feed(i);
+        if (end) break;
+        tick(i);
+        allocated += tickAllocations;
+        quiet += tickAllocations == 0;
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint32_t ran = i - firstTick;
+    if (savePath != nullptr && !end) {
+        saveGame(savePath, i);
+    }
+
+    std::cout.rdbuf(terminal);
+    std::cout << "Seed: " << rng.seed << '\n';
+    std::cout << "Ticks: " << ran << (firstTick ? " from tick " + std::to_string(firstTick) : "") << (end ? " (player died)" : "") << '\n';
+    std::cout << "Elapsed: " << elapsed * 1000 << " ms (" << (elapsed > 0 ? ran / elapsed : 0) << " ticks/s)\n";
+    std::cout << "Walkers: " << Walker::walkers.size() << ", Archers: " << Archer::archers.size()
+              << ", Chickens: " << Chicken::chickens.size() << ", Eggs: " << Egg::eggs.size()
+              << ", Walls: " << Wall::walls.size() << '\n';
+    std::cout << "Allocations: " << allocated << " during the ticks, none in " << quiet << " of them\n";
+    if (replay.mode == Replay::Mode::PLAY) {
+        std::cout << "Replay: " << replay.events.size() << " keys, " << (replay.finished() ? "finished" : "not finished")
+                  << ", " << replay.desyncs << " desyncs\n";
+    }
+    std::flush(std::cout);
+    return 0;
+}
+
+Random& mobStream() {
+    return region != nullptr ? region->random : rng.mobs;
+}
+Random& combatStream() {
+    return region != nullptr ? region->random : rng.combat;
+}
+
+void seedRegions(uint32_t tick) {
+    uint64_t seed = rng.seed ^ ((uint64_t)tick * 0x9e3779b97f4a7c15ULL);
+    for (size_t r=0; r<regions.size(); r++) {
+        regions[r].random.reseed(seed, REGION_STREAM + r);
+    }
+}
+
+// Rare per-tick and per-move events draw how long until they happen instead of rolling every time
+void schedule(Egg* egg) {
+    if (egg->hatchTick == 0) {
+        egg->hatchTick = currentTick + mobStream().geometric(eggSelfHatchingDistribution.p());
+    }
+    timers.add(egg->hatchTick, Timer{Type::EGG, egg->handle});
+}
+void schedule(Archer* archer) {
+    if (archer->shotTick == 0) {
+        archer->shotTick = currentTick + combatStream().geometric(Archer::shootDistribution.p());
+    }
+    timers.add(archer->shotTick, Timer{Type::ARCHER, archer->handle});
+}
+void schedule(Chicken* chicken) {
+    if (chicken->movesToEgg == 0) {
+        chicken->movesToEgg = mobStream().geometric(Chicken::eggDistribution.p());
+    }
+}
+void schedule(Wall* wall) {
+    if (wall->strength > 0) return;
+    Handle handle = wall->handle;
+    after(1, [handle]() {
+        if (Wall* wall = Wall::walls.get(handle)) Wall::removeWall(wall);
+    });
+}
+
+Entity* timerEntity(const Timer& timer) {
+    switch (timer.type) {
+        case Type::EGG: return Egg::eggs.get(timer.handle);
+        case Type::ARCHER: return Archer::archers.get(timer.handle);
+        default: return nullptr;
+    }
+}
+
+void fireTimers(uint32_t tick) {
+    std::pmr::vector<Timer> due(&tickArena);
+    timers.take(tick, due);
+    due.erase(std::remove_if(due.begin(), due.end(), [](const Timer& timer) {
+        return timerEntity(timer) == nullptr; // Removed since it was scheduled
+    }), due.end());
+    // Snapshots don't keep the order the timers were added in, the type and the cell give one that survives them
+    std::sort(due.begin(), due.end(), [](const Timer& a, const Timer& b) {
+        if (a.type != b.type) return a.type < b.type;
+        sista::Coordinates first = timerEntity(a)->getCoordinates();
+        sista::Coordinates second = timerEntity(b)->getCoordinates();
+        return first.y != second.y ? first.y < second.y : first.x < second.x;
+    });
+    for (const Timer& timer : due) {
+        if (timer.type == Type::ARCHER) {
+            Archer* archer = Archer::archers.get(timer.handle);
             if (archer == nullptr) continue;
-            if (Archer::movingDistribution(rng)) {
-                archer->move();
-            }
-            if (Archer::shootDistribution(rng)) {
-                archer->shoot();
-            }
-        }
-        for (unsigned w=0; w<Weasel::weasels.size(); w++) {
-            if (w >= Weasel::weasels.size()) break;
-            Weasel* weasel = Weasel::weasels[w].get();
-            if (weasel == nullptr) continue;
-            weasel->move();
-        }
-        for (unsigned s=0; s<Snake::snakes.size(); s++) {
-            if (s >= Snake::snakes.size()) break;
-            Snake* snake = Snake::snakes[s].get();
-            if (snake == nullptr) continue;
-            snake->move();
-        }
-        for (unsigned w=0; w<Wall::walls.size(); w++) {
-            if (w >= Wall::walls.size()) break;
-            Wall* wall = Wall::walls[w].get();
-            if (wall == nullptr) continue;
-            if (wall->strength == 0) {
-                Wall::removeWall(wall);
-            }
-        }
-        // Iterate over wild animals to see if they have reached the other side of the field or they have been caught
-        for (unsigned w=0; w<Weasel::weasels.size(); w++) {
-            if (w >= Weasel::weasels.size()) break;
-            Weasel* weasel = Weasel::weasels[w].get();
-            if (weasel == nullptr) continue;
-            if (weasel->crossed) {
-                Weasel::removeWeasel(weasel);
-            } else if (weasel->caught) {
-                Weasel::removeWeasel(weasel);
-                Player::player->inventory.meat += 2;
-            }
-        }
-        for (unsigned s=0; s<Snake::snakes.size(); s++) {
-            if (s >= Snake::snakes.size()) break;
-            Snake* snake = Snake::snakes[s].get();
-            if (snake == nullptr) continue;
-            if (snake->crossed) {
-                Snake::removeSnake(snake);
+            archer->shoot();
+            archer->shotTick = 0;
+            schedule(archer);
+        } else if (timer.type == Type::EGG) {
+            Egg* egg = Egg::eggs.get(timer.handle);
+            if (egg == nullptr) continue;
+            sista::Coordinates coords = egg->getCoordinates();
+            bool hatched = Egg::hatchingDistribution(mobStream());
+            Egg::removeEgg(egg);
+            if (hatched) {
+                spawn(Chicken::chickens, makePooled<Chicken>(coords));
             }
         }
+    }
+}
 
-        #if REPOPULATE
-        if (i % 128 == 127) {
-            // repopulate the field from scratch for preventing nullptr pawns from laying around
-            repopulate(field);
+// Mobs inside a region only touch cells of that region, so the regions are updated in parallel while their
+// slot map changes wait; those are applied in region order, then the mobs near the edges are updated one by one
+template <typename T, typename F>
+void updateRegions(SlotMap<T>& entities, F update) {
+    std::pmr::vector<std::pmr::vector<T*>> inner(regions.size(), &tickArena);
+    std::pmr::vector<std::shared_ptr<T>> edges(&tickArena); // Owned, as they erase each other at once
+    for (const std::shared_ptr<T>& entity : entities) {
+        unsigned short y = entity->getCoordinates().y;
+        size_t r = y / REGION_HEIGHT;
+        unsigned short row = y % REGION_HEIGHT;
+        bool clearAbove = r == 0 || row >= REGION_MARGIN;
+        bool clearBelow = r + 1 == regions.size() || row + REGION_MARGIN < REGION_HEIGHT;
+        if (clearAbove && clearBelow) {
+            inner[r].push_back(entity.get());
+        } else {
+            edges.push_back(entity);
         }
-        #endif
-        #if __linux__
-        if (i % 10 == 9) {
-        #elif __APPLE__ or _WIN32
-        if (i % 100 == 99) {
-        #endif
-            // reprint the field every 10 frames
-            sista::clearScreen();
-            field->print(border);
+    }
+    auto updateRegion = [&update, &inner](size_t r) {
+        region = &regions[r];
+        for (T* entity : inner[r]) {
+            if (entity->registered) update(entity); // Not if another mob of the region removed it
         }
-        // Spawn new entities
-        spawnNew(field);
+        region = nullptr;
+    };
+    if (entities.size() - edges.size() >= PARALLEL_MOBS) {
+        workers.run(regions.size(), updateRegion);
+    } else {
+        for (size_t r=0; r<regions.size(); r++) updateRegion(r); // Same results, without waking the workers
+    }
+    for (Region& each : regions) {
+        for (Change& change : each.deferred) change.apply(change);
+        each.deferred.clear();
+        for (auto& [tick, callback] : each.delayed) events.add(tick, std::move(callback));
+        each.delayed.clear();
+    }
+    for (const std::shared_ptr<T>& entity : edges) {
+        if (entity->registered) update(entity.get());
+    }
+}
 
-        // Print inventory, time and instructions
-        printSideInstructions(i, dayCountdown, nightCountdown);
-        std::flush(std::cout);
+void after(uint32_t ticks, std::function<void()> callback) {
+    uint32_t tick = currentTick + std::max(ticks, 1u);
+    if (region != nullptr) {
+        region->delayed.emplace_back(tick, std::move(callback));
+    } else {
+        events.add(tick, std::move(callback));
     }
+}
+// Scheduled by index, so that the callback is not copied every time
+void repeat(size_t index) {
+    uint32_t period = periodic[index].first;
+    events.add((currentTick / period + 1) * period, [index]() {
+        periodic[index].second();
+        repeat(index);
+    });
+}
+void every(uint32_t period, std::function<void()> callback) {
+    periodic.emplace_back(period, std::move(callback));
+    repeat(periodic.size() - 1);
+}
 
-    th.join();
-    field->clear();
-    cursor.goTo(72, 0); // Move the cursor to the bottom of the screen, so the terminal is not left in a weird state
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-    flushInput();
-    #if __linux__
-        getch();
-    #elif __APPLE__
-        getchar();
-    #elif _WIN32
-        getch();
+void switchDaylight() {
+    day = !day;
+    if (day) {
+        // The day is back, but the out-of-control player destroys the inventory
+        Player::player->inventory = Inventory{0, 0, 0};
+    }
+    applyDaylight();
+    fullRedraw = true;
+    nextSwitch += day ? DAY_DURATION : NIGHT_DURATION;
+    events.add(nextSwitch, switchDaylight);
+}
+
+void scheduleEvents() {
+    events.add(nextSwitch, switchDaylight);
+    every(RESYNC_PERIOD, []() {
+        fullRedraw = true; // Rarely reprint everything, in case the terminal got out of sync
+    });
+    #if REPOPULATE
+    every(128, []() {
+        // repopulate the field from scratch for preventing nullptr pawns from laying around
+        repopulate(field);
+    });
     #endif
-    #ifdef __APPLE__
-        // system("stty -raw echo");
-        tcsetattr(0, TCSANOW, &orig_termios);
+}
+
+void fireEvents(uint32_t tick) {
+    std::pmr::vector<std::function<void()>> due(&tickArena);
+    events.take(tick, due);
+    for (std::function<void()>& callback : due) callback();
+}
+
+void tick(int i) {
+    uint64_t allocated = allocations.load(std::memory_order_relaxed);
+    currentTick = i;
+    generateAround(field, Player::player->getCoordinates());
+    if (!day) {
+        // Implement lycanthropy for the user, randomly picking a game key
+        char key = gameKeys[rng.player.below(gameKeys.size())];
+        replay.check(i, key);
+        act(key);
+    }
+    fireEvents(i); // Daylight switches, crumbled walls, periodic reprints
+    moveProjectiles();
+    Mine::explodeTriggered();
+    Chest::chests.forEach([](Chest* chest) {
+        if (chest->inventory.walls == 0 && chest->inventory.eggs == 0 && chest->inventory.meat == 0) {
+            Chest::removeChest(chest);
+        }
+    });
+    seedRegions(i);
+    updateRegions(Chicken::chickens, [](Chicken* chicken) {
+        if (Chicken::movingDistribution(mobStream())) {
+            chicken->move();
+        }
+    });
+    flowField.update(field, Player::player->getCoordinates());
+    moveWalkers();
+    updateRegions(Archer::archers, [](Archer* archer) {
+        if (Archer::movingDistribution(mobStream())) {
+            archer->move();
+        }
+    });
+    fireTimers(i); // Archers shooting and eggs hatching by themselves
+    updateRegions(Weasel::weasels, [](Weasel* weasel) {
+        weasel->move();
+    });
+    updateRegions(Snake::snakes, [](Snake* snake) {
+        snake->move();
+    });
+    // Iterate over wild animals to see if they have reached the other side of the field or they have been caught
+    Weasel::weasels.forEach([](Weasel* weasel) {
+        if (weasel->crossed) {
+            Weasel::removeWeasel(weasel);
+        } else if (weasel->caught) {
+            Weasel::removeWeasel(weasel);
+            Player::player->inventory.meat += 2;
+        }
+    });
+    Snake::snakes.forEach([](Snake* snake) {
+        if (snake->crossed) {
+            Snake::removeSnake(snake);
+        }
+    });
+
+    // Spawn new entities
+    spawnNew(field);
+    #if DEBUG
+    checkRegistry();
     #endif
+    tickArena.release(); // Every scratch container of the tick is gone by now
+    tickAllocations = allocations.load(std::memory_order_relaxed) - allocated;
 }
 
 void tutorial() {
@@ -462,14 +660,9 @@ void tutorial() {
     sista::resetAnsi();
     std::cout << "' symbol" << std::endl;
 
-    #if __linux__ or _WIN32
-        getch();
-    #elif __APPLE__
-        getchar();
-    #endif
+    getch();
 
-    Chicken::chickens.push_back(std::make_shared<Chicken>(sista::Coordinates{3, 5}));
-    field->addPrintPawn(Chicken::chickens.back());
+    spawn(Chicken::chickens, makePooled<Chicken>(sista::Coordinates{3, 5}));
     sista::resetAnsi();
     cursor.goTo(7, 10);
     std::cout << "Chickens are represented by the '";
@@ -484,14 +677,9 @@ void tutorial() {
     sista::resetAnsi();
     std::cout << "' symbol" << std::endl;
 
-    #if __linux__ or _WIN32
-        getch();
-    #elif __APPLE__
-        getchar();
-    #endif
+    getch();
 
-    Egg::eggs.push_back(std::make_shared<Egg>(sista::Coordinates{4, 5}));
-    field->addPrintPawn(Egg::eggs.back());
+    spawn(Egg::eggs, makePooled<Egg>(sista::Coordinates{4, 5}));
     sista::resetAnsi();
     cursor.goTo(10, 10);
     std::cout << "You can collect items by being in a neighboring cell" << std::endl;
@@ -511,11 +699,7 @@ void tutorial() {
         // Take input and move the player
         char input = '_';
         while (input != 'w' && input != 'a' && input != 's' && input != 'd') {
-            #if defined(_WIN32) or defined(__linux__)
-                input = getch();
-            #elif __APPLE__
-                input = getchar();
-            #endif
+            input = getch();
         }
         act(input);
         std::flush(std::cout);
@@ -529,11 +713,7 @@ void tutorial() {
     sista::resetAnsi();
     char input = '_';
     while (input != 'c' && input != 'C') {
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
+        input = getch();
     }
     Player::player->mode = Player::Mode::COLLECT;
 
@@ -545,11 +725,7 @@ void tutorial() {
         // Take input and move the player
         char input = '_';
         while (input != 'i' && input != 'j' && input != 'k' && input != 'l') {
-            #if defined(_WIN32) or defined(__linux__)
-                input = getch();
-            #elif __APPLE__
-                input = getchar();
-            #endif
+            input = getch();
         }
         sista::Coordinates target = Player::player->getCoordinates();
         switch (input) {
@@ -579,11 +755,7 @@ void tutorial() {
     std::cout << "You have collected the egg, now press 'b' to enter bullet mode" << std::endl;
     input = '_';
     while (input != 'b' && input != 'B') {
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
+        input = getch();
     }
     Player::player->mode = Player::Mode::BULLET;
     std::flush(std::cout);
@@ -591,8 +763,7 @@ void tutorial() {
     // Add an archer 5 blocks away from the player
     sista::Coordinates archerCoords = Player::player->getCoordinates();
     archerCoords.y += 5;
-    Archer::archers.push_back(std::make_shared<Archer>(archerCoords));
-    field->addPrintPawn(Archer::archers.back());
+    spawn(Archer::archers, makePooled<Archer>(archerCoords));
 
     sista::resetAnsi();
     cursor.goTo(16, 10);
@@ -601,11 +772,7 @@ void tutorial() {
     std::cout << "Choose among 'i', 'j', 'k', 'l' the right direction to shoot the egg" << std::endl;
 
     while (input != 'i' && input != 'j' && input != 'k' && input != 'l') {
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
+        input = getch();
     }
     act(input);
     std::flush(std::cout);
@@ -613,8 +780,7 @@ void tutorial() {
     // We have to move the bullet until it hits the archer
     while (Bullet::bullets.size() > 0) {
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        std::shared_ptr<Bullet> bullet = Bullet::bullets[0];
-        bullet->move();
+        moveProjectiles();
         std::flush(std::cout);
     }
 
@@ -633,19 +799,14 @@ void tutorial() {
     // Add a wall 5 blocks away from the player
     sista::Coordinates wallCoords = Player::player->getCoordinates();
     wallCoords.x -= 3;
-    Wall::walls.push_back(std::make_shared<Wall>(wallCoords, 3));
-    field->addPrintPawn(Wall::walls.back());
+    spawn(Wall::walls, makePooled<Wall>(wallCoords, 3));
     std::flush(std::cout);
 
     input = '_';
     while (true) {
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
+        input = getch();
         act(input);
-        printSideInstructions(0, DAY_DURATION, NIGHT_DURATION);
+        printSideInstructions(0, DAY_DURATION);
         std::flush(std::cout);
         if (Player::player->inventory.walls > 0) {
             break;
@@ -658,14 +819,10 @@ void tutorial() {
     std::cout << "Wall collected, now press '#' or '=' to enter wall mode" << std::endl;
     input = '_';
     while (input != '#' && input != '=' && input != '0') {
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
+        input = getch();
     }
     Player::player->mode = Player::Mode::WALL;
-    printSideInstructions(0, DAY_DURATION, NIGHT_DURATION);
+    printSideInstructions(0, DAY_DURATION);
     std::flush(std::cout);
 
     sista::resetAnsi();
@@ -674,11 +831,7 @@ void tutorial() {
 
     input = '_';
     while (input != 'i' && input != 'j' && input != 'k' && input != 'l') {
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
+        input = getch();
     }
     act(input);
     std::flush(std::cout);
@@ -693,87 +846,78 @@ void tutorial() {
     cursor.goTo(28, 10);
     std::cout << "Press any key to start the game" << std::endl;
 
-    #if defined(_WIN32) or defined(__linux__)
-        getch();
-    #elif __APPLE__
-        getchar();
-    #endif
+    getch();
 }
 
 void input() {
-    char input = '_';
-    while (input != 'Q' /*&& input != 'q'*/) {
-        if (end) return;
-        #if defined(_WIN32) or defined(__linux__)
-            input = getch();
-        #elif __APPLE__
-            input = getchar();
-        #endif
-        if (end) return;
-        if (day) {
-            act(input);
-        } else {
-            // At night only game control keys are processed
-            switch (input) {
-                case '+': case '-':
-                    speedup = !speedup;
-                    break;
-                case '.': case 'p': case 'P':
-                    pause_ = !pause_;
-                    break;
-                case 'Q': /* case 'q': */
-                    end = true;
-                    return;
-                default:
-                    break;
-            }
+    char keys[INPUT_BATCH];
+    while (!end) {
+        int count = readKeys(keys, INPUT_BATCH, INPUT_TIMEOUT);
+        if (count < 0) { // Stdin was closed, nobody can play anymore
+            end = true;
+            return;
+        }
+        for (int k=0; k<count; k++) {
+            keyQueue.push(keys[k]); // If the main loop is that far behind the key is lost
+        }
+    }
+}
+
+void drainKeys(int tick, bool controlOnly) {
+    char input;
+    while (keyQueue.pop(input)) {
+        switch (input) {
+            case '+': case '-':
+                speedup = !speedup;
+                break;
+            case '.': case 'p': case 'P':
+                pause_ = !pause_;
+                break;
+            case 'x': case 'X':
+                saveStatus = saveGame(savePath != nullptr ? savePath : SAVE_FILE, tick) ? "Saved      " : "Save failed";
+                break;
+            case 'Q': /* case 'q': */
+                replay.record(tick, input);
+                end = true;
+                return;
+            default:
+                // At night, while paused and while replaying only game control keys are processed
+                if (day && !controlOnly && std::find(gameKeys.begin(), gameKeys.end(), input) != gameKeys.end()) {
+                    replay.record(tick, input); // Only the keys act() handles, which are ASCII, so the top bit stays free for lycanthropy
+                    act(input);
+                }
+                break;
         }
     }
 }
 
 void act(char input) {
     switch (input) {
-        case 'w': case 'W': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'w': case 'W':
             Player::player->move(Direction::UP);
             break;
-        }
-        case 'a': case 'A': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'a': case 'A':
             Player::player->move(Direction::LEFT);
             break;
-        }
-        case 's': case 'S': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 's': case 'S':
             Player::player->move(Direction::DOWN);
             break;
-        }
-        case 'd': case 'D': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'd': case 'D':
             Player::player->move(Direction::RIGHT);
             break;
-        }
 
-        case 'j': case 'J': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'j': case 'J':
             Player::player->shoot(Direction::LEFT);
             break;
-        }
-        case 'k': case 'K': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'k': case 'K':
             Player::player->shoot(Direction::DOWN);
             break;
-        }
-        case 'l': case 'L': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'l': case 'L':
             Player::player->shoot(Direction::RIGHT);
             break;
-        }
-        case 'i': case 'I': {
-            std::lock_guard<std::mutex> lock(streamMutex);
+        case 'i': case 'I':
             Player::player->shoot(Direction::UP);
             break;
-        }
 
         case 'c': case 'C':
             Player::player->mode = Player::Mode::COLLECT;
@@ -817,7 +961,7 @@ void act(char input) {
 void printIntro() {
     std::cout << CLS; // Clear screen
     std::cout << SSB; // Clear scrollback buffer
-    field->print(border);
+    printBorder(viewHeight, viewWidth);
     cursor.goTo(5, 0);
     // if linux
     #if __linux__ or __APPLE__
@@ -841,6 +985,7 @@ void printIntro() {
     std::cout << "\t- '\x1b[35mg\x1b[0m' or '\x1b[35mG\x1b[0m' to select gates\n";
     std::cout << "\t- '\x1b[35mt\x1b[0m' or '\x1b[35mT\x1b[0m' to select traps\n";
     std::cout << "\t- '\x1b[35mh\x1b[0m' or '\x1b[35mH\x1b[0m' to enter egg-hatching mode\n";
+    std::cout << "\t- '\x1b[35mx\x1b[0m' to save the game\n";
     std::cout << "\t- '\x1b[35mQ\x1b[0m' to quit\n\n";
 
     std::cout << "\tMake sure to have the terminal full-screen\n";
@@ -851,20 +996,20 @@ void printIntro() {
     std::flush(std::cout);
 }
 
-void printSideInstructions(int i, int dayCountdown, int nightCountdown) {
+void printSideInstructions(int i, int countdown) {
     // Print the inventory
     sista::resetAnsi();
-    cursor.goTo(3, WIDTH+10);
+    cursor.goTo(3, viewWidth+10);
     sista::setAttribute(sista::Attribute::BRIGHT);
     std::cout << "Inventory\n";
     sista::resetAttribute(sista::Attribute::BRIGHT);
-    cursor.goTo(4, WIDTH+10);
+    cursor.goTo(4, viewWidth+10);
     std::cout << "Walls: " << Player::player->inventory.walls << "   \n";
-    cursor.goTo(5, WIDTH+10);
+    cursor.goTo(5, viewWidth+10);
     std::cout << "Eggs: " << Player::player->inventory.eggs << "   \n";
-    cursor.goTo(6, WIDTH+10);
+    cursor.goTo(6, viewWidth+10);
     std::cout << "Meat: " << Player::player->inventory.meat << "   \n";
-    cursor.goTo(7, WIDTH+10);
+    cursor.goTo(7, viewWidth+10);
     std::cout << "Mode: ";
     switch (Player::player->mode) {
         case Player::Mode::COLLECT:
@@ -893,213 +1038,763 @@ void printSideInstructions(int i, int dayCountdown, int nightCountdown) {
             break;
     }
     std::cout << "      ";
-    cursor.goTo(10, WIDTH+10);
+    cursor.goTo(10, viewWidth+10);
     sista::setAttribute(sista::Attribute::BRIGHT);
     std::cout << "Time survived: " << i << "    \n";
     sista::resetAttribute(sista::Attribute::BRIGHT);
-    cursor.goTo(11, WIDTH+10);
+    cursor.goTo(11, viewWidth+10);
     sista::setAttribute(sista::Attribute::BRIGHT);
     std::cout << "Time before ";
-    if (day) {
-        std::cout << "night: " << nightCountdown << "    \n";
-    } else {
-        std::cout << "day: " << dayCountdown << "    \n";
-    }
+    std::cout << (day ? "night: " : "day: ") << countdown << "    \n";
     sista::resetAttribute(sista::Attribute::BRIGHT);
-    // Be aware not to overwrite the inventory and the time survived which use {3, WIDTH+10} to ~{11, WIDTH+10}
-    #if __linux__
-    if (i % 10 == 9) {
-    #elif __APPLE__ or _WIN32
-    if (i % 100 == 99 || i == 0) {
-    #endif
-        cursor.goTo(14, WIDTH+10);
-        sista::setAttribute(sista::Attribute::BRIGHT);
-        std::cout << "Instructions\n";
-        sista::resetAttribute(sista::Attribute::BRIGHT);
-        cursor.goTo(15, WIDTH+10);
-        std::cout << "Move: \x1b[35mw\x1b[37m | \x1b[35ma\x1b[37m | \x1b[35ms\x1b[37m | \x1b[35md\x1b[37m\n";
-        cursor.goTo(16, WIDTH+10);
-        std::cout << "Act: \x1b[35mi\x1b[37m | \x1b[35mj\x1b[37m | \x1b[35mk\x1b[37m | \x1b[35ml\x1b[37m\n";
-        cursor.goTo(18, WIDTH+10);
-        std::cout << "Collect mode: \x1b[35mc\x1b[37m\n";
-        cursor.goTo(19, WIDTH+10);
-        std::cout << "Bullet mode: \x1b[35mb\x1b[37m\n";
-        cursor.goTo(20, WIDTH+10);
-        std::cout << "Dump Chest mode: \x1b[35me\x1b[37m\n";
-        cursor.goTo(21, WIDTH+10);
-        std::cout << "Build Wall mode: \x1b[35m=\x1b[37m | \x1b[35m0\x1b[37m | \x1b[35m#\x1b[37m\n";
-        cursor.goTo(22, WIDTH+10);
-        std::cout << "Build Gate mode: \x1b[35mg\x1b[37m\n";
-        cursor.goTo(23, WIDTH+10);
-        std::cout << "Place Trap mode: \x1b[35mt\x1b[37m\n";
-        cursor.goTo(24, WIDTH+10);
-        std::cout << "Place Mine mode: \x1b[35mm\x1b[37m | \x1b[35m*\x1b[37m\n";
-        cursor.goTo(25, WIDTH+10);
-        std::cout << "Egg-hatching mode: \x1b[35mh\x1b[37m\n";
-        cursor.goTo(27, WIDTH+10);
-        std::cout << "Speedup mode: \x1b[35m+\x1b[37m | \x1b[35m-\x1b[37m\n";
-        cursor.goTo(28, WIDTH+10);
-        std::cout << "Pause or resume: \x1b[35m.\x1b[37m | \x1b[35mp\x1b[37m\n";
-        cursor.goTo(29, WIDTH+10);
-        std::cout << "Quit: \x1b[35mQ\x1b[37m\n";
-    }
-}
-
-void populate(sista::SwappableField* field) {
-    // Walls, some randomly around the field and some in a row
-    sista::Coordinates coordinates;
-    for (int j=0; j<5; j++) {
-        int length = rand() % (HEIGHT - 10) + 1;
-        int start_column = rand() % (WIDTH - length);
-        int row = rand() % (HEIGHT - 10);
-        for (int i=0; i<length; i++) {
-            coordinates = {row, start_column + i};
-            if (field->isFree(coordinates)) {
-                Wall::walls.push_back(std::make_shared<Wall>(coordinates, rand() % 2 + 1));
-                field->addPrintPawn(Wall::walls.back());
-            }
-        }
+}
+
+void printInstructions() {
+    // Be aware not to overwrite the inventory and the time survived which use {3, viewWidth+10} to ~{11, viewWidth+10}
+    cursor.goTo(14, viewWidth+10);
+    sista::setAttribute(sista::Attribute::BRIGHT);
+    std::cout << "Instructions\n";
+    sista::resetAttribute(sista::Attribute::BRIGHT);
+    cursor.goTo(15, viewWidth+10);
+    std::cout << "Move: \x1b[35mw\x1b[37m | \x1b[35ma\x1b[37m | \x1b[35ms\x1b[37m | \x1b[35md\x1b[37m\n";
+    cursor.goTo(16, viewWidth+10);
+    std::cout << "Act: \x1b[35mi\x1b[37m | \x1b[35mj\x1b[37m | \x1b[35mk\x1b[37m | \x1b[35ml\x1b[37m\n";
+    cursor.goTo(18, viewWidth+10);
+    std::cout << "Collect mode: \x1b[35mc\x1b[37m\n";
+    cursor.goTo(19, viewWidth+10);
+    std::cout << "Bullet mode: \x1b[35mb\x1b[37m\n";
+    cursor.goTo(20, viewWidth+10);
+    std::cout << "Dump Chest mode: \x1b[35me\x1b[37m\n";
+    cursor.goTo(21, viewWidth+10);
+    std::cout << "Build Wall mode: \x1b[35m=\x1b[37m | \x1b[35m0\x1b[37m | \x1b[35m#\x1b[37m\n";
+    cursor.goTo(22, viewWidth+10);
+    std::cout << "Build Gate mode: \x1b[35mg\x1b[37m\n";
+    cursor.goTo(23, viewWidth+10);
+    std::cout << "Place Trap mode: \x1b[35mt\x1b[37m\n";
+    cursor.goTo(24, viewWidth+10);
+    std::cout << "Place Mine mode: \x1b[35mm\x1b[37m | \x1b[35m*\x1b[37m\n";
+    cursor.goTo(25, viewWidth+10);
+    std::cout << "Egg-hatching mode: \x1b[35mh\x1b[37m\n";
+    cursor.goTo(27, viewWidth+10);
+    std::cout << "Speedup mode: \x1b[35m+\x1b[37m | \x1b[35m-\x1b[37m\n";
+    cursor.goTo(28, viewWidth+10);
+    std::cout << "Pause or resume: \x1b[35m.\x1b[37m | \x1b[35mp\x1b[37m\n";
+    cursor.goTo(29, viewWidth+10);
+    std::cout << "Quit: \x1b[35mQ\x1b[37m\n";
+    cursor.goTo(30, viewWidth+10);
+    std::cout << "Save: \x1b[35mx\x1b[37m\n";
+}
+
+void printBorder(int height, int width) {
+    // Moves relative to the first cell of the field, so it doesn't depend on where Sista puts the field
+    cursor.goTo(0, 0);
+    std::cout << "\x1b[A\x1b[D";
+    for (int x=0; x<width+2; x++) border.print(false);
+    for (unsigned short y=0; y<height; y++) {
+        cursor.goTo(y, 0);
+        std::cout << "\x1b[D";
+        border.print(false);
+        cursor.goTo(y, width);
+        border.print(false);
+    }
+    cursor.goTo(height, 0);
+    std::cout << "\x1b[D";
+    for (int x=0; x<width+2; x++) border.print(false);
+    sista::resetAnsi();
+}
+
+Scheduler::Scheduler(double ticksPerSecond, Policy policy) : policy(policy) {
+    setRate(ticksPerSecond);
+    reset();
+}
+void Scheduler::setRate(double ticksPerSecond) {
+    period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / ticksPerSecond));
+    period = std::max(period, std::chrono::steady_clock::duration(1)); // wait() divides by it
+}
+void Scheduler::reset() {
+    deadline = std::chrono::steady_clock::now() + period;
+}
+void Scheduler::wait() {
+    auto now = std::chrono::steady_clock::now();
+    if (now <= deadline) {
+        std::this_thread::sleep_until(deadline);
+        deadline += period; // From the deadline, not from now, so the overshoot is not accumulated
+        late = false;
+        return;
     }
-    for (int i=0; i<HEIGHT; i++) {
-        coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Wall::walls.push_back(std::make_shared<Wall>(coordinates, rand() % 2 + 1));
-            field->addPrintPawn(Wall::walls.back());
-        }
+    auto lateness = now - deadline;
+    missed++;
+    if (lateness > worstLateness) worstLateness = lateness;
+    if (policy == Policy::CATCH_UP && lateness < period * MAX_CATCH_UP) {
+        deadline += period; // Run this tick right away, the next ones too until back on schedule
+        late = true;
+    } else {
+        // Drop the ticks that should already have happened and stay aligned to the period
+        auto behind = lateness / period;
+        skipped += behind;
+        deadline += period * (behind + 1);
+        late = false;
     }
-    // Chests, a couple of them
-    for (int i=0; i<3; i++) {
-        coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Chest::chests.push_back(std::make_shared<Chest>(coordinates, Inventory{(short)(rand() % 5), (short)(rand() % 5), 0}, true));
-            field->addPrintPawn(Chest::chests.back());
-        }
+}
+
+void applyDaylight() {
+    if (day) {
+        Player::player->setSettings(Player::playerStyle);
+        border = sista::Border(
+            '@', {
+                sista::ForegroundColor::BLACK,
+                sista::BackgroundColor::WHITE,
+                sista::Attribute::BRIGHT
+            }
+        );
+    } else {
+        // The player is now out of control
+        Player::player->setSettings(nightPlayerStyle);
+        border = sista::Border(
+            '@', {
+                sista::ForegroundColor::WHITE,
+                sista::BackgroundColor::BLACK,
+                sista::Attribute::BRIGHT
+            }
+        );
     }
-    // Walkers, some randomly around the field, but none of them in a 5x5 square around the player, which starts in {0, 0}
-    for (int i=0; i<5; i++) {
-        coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates) && coordinates.y > 5 && coordinates.x > 5) {
-            Walker::walkers.push_back(std::make_shared<Walker>(coordinates));
-            field->addPrintPawn(Walker::walkers.back());
+}
+
+bool Replay::start(const char* path, uint64_t seed_) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    mode = Mode::RECORD;
+    seed = seed_;
+    file.write(REPLAY_MAGIC, 4);
+    uint16_t version = REPLAY_VERSION;
+    for (int b=0; b<2; b++) file.put((char)(version >> (8 * b)));
+    for (int b=0; b<8; b++) file.put((char)(seed >> (8 * b)));
+    for (int b=0; b<2; b++) file.put((char)(worldWidth >> (8 * b)));
+    for (int b=0; b<2; b++) file.put((char)(worldHeight >> (8 * b)));
+    file.flush();
+    return true;
+}
+bool Replay::load(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < 18 || memcmp(data.data(), REPLAY_MAGIC, 4) != 0) return false;
+    if ((data[4] | data[5] << 8) != REPLAY_VERSION) return false;
+    seed = 0;
+    for (int b=0; b<8; b++) seed |= (uint64_t)data[6 + b] << (8 * b);
+    width = data[14] | data[15] << 8;
+    height = data[16] | data[17] << 8;
+    uint32_t tick = 0;
+    for (size_t i=18; i<data.size();) {
+        // Tick delta as a LEB128 varint, then the key with its top bit set for lycanthropy
+        uint32_t delta = 0;
+        for (int shift=0; i<data.size(); shift+=7) {
+            unsigned char byte = data[i++];
+            delta |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        if (i >= data.size()) return false; // Truncated, probably the game crashed while writing
+        tick += delta;
+        unsigned char key = data[i++];
+        events.push_back({tick, (char)(key & 0x7f), (key & 0x80) != 0});
+    }
+    mode = Mode::PLAY;
+    return true;
+}
+void Replay::record(uint32_t tick, char key, bool lycanthropy) {
+    if (mode != Mode::RECORD) return;
+    uint32_t delta = tick - lastTick;
+    lastTick = tick;
+    do {
+        unsigned char byte = delta & 0x7f;
+        delta >>= 7;
+        file.put((char)(delta ? byte | 0x80 : byte));
+    } while (delta);
+    file.put((char)(lycanthropy ? key | 0x80 : key));
+    file.flush(); // Whatever happens next, the file is usable up to this key
+}
+void Replay::feed(uint32_t tick) {
+    if (mode != Mode::PLAY) return;
+    while (cursor < events.size() && events[cursor].tick <= tick) {
+        if (events[cursor].lycanthropy) {
+            if (events[cursor].tick == tick) break; // Checked by tick() itself
+            desyncs++; // That night did not come at the same time
+            cursor++;
+            continue;
+        }
+        char key = events[cursor++].key;
+        if (key == 'Q') {
+            end = true;
+            return;
         }
+        act(key);
     }
-    // Archers, some randomly around the field, but none in the same row or column as the player
-    for (int i=0; i<5; i++) {
-        coordinates = {rand() % (HEIGHT - 5) + 5, rand() % (WIDTH - 5) + 5};
-        if (field->isFree(coordinates)) {
-            Archer::archers.push_back(std::make_shared<Archer>(coordinates));
-            field->addPrintPawn(Archer::archers.back());
+}
+void Replay::check(uint32_t tick, char key) {
+    if (mode == Mode::RECORD) {
+        record(tick, key, true);
+    } else if (mode == Mode::PLAY) {
+        if (cursor < events.size() && events[cursor].tick == tick && events[cursor].lycanthropy) {
+            if (events[cursor++].key != key) desyncs++;
+        } else {
+            desyncs++;
         }
     }
-    // Only one Weasel, to be generated from the left side of the field
-    coordinates = {rand() % HEIGHT, 0};
-    if (field->isFree(coordinates)) {
-        Weasel::weasels.push_back(std::make_shared<Weasel>(coordinates, Direction::RIGHT));
-        field->addPrintPawn(Weasel::weasels.back());
+}
+
+struct SnapshotWriter {
+    std::vector<char> data;
+
+    template <typename T>
+    void put(T value) {
+        // Little endian whatever the machine, so snapshots can be moved around
+        for (size_t b=0; b<sizeof(T); b++) data.push_back((char)((uint64_t)value >> (8 * b)));
     }
-    // Only one Snake, to be generated from the right side of the field
-    coordinates = {rand() % (HEIGHT - 10), WIDTH - 1};
-    if (field->isFree(coordinates)) {
-        Snake::snakes.push_back(std::make_shared<Snake>(coordinates, Direction::LEFT));
-        field->addPrintPawn(Snake::snakes.back());
+    void put(Entity* entity) {
+        put(entity->getCoordinates().y);
+        put(entity->getCoordinates().x);
     }
-    // Some Chickens, randomly around the field
-    for (int i=0; i<5; i++) {
-        coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Chicken::chickens.push_back(std::make_shared<Chicken>(coordinates));
-            field->addPrintPawn(Chicken::chickens.back());
-        }
+};
+struct SnapshotReader {
+    const std::vector<char>& data;
+    size_t offset = 0;
+    bool failed = false;
+
+    template <typename T>
+    T get() {
+        if (offset + sizeof(T) > data.size()) {
+            failed = true;
+            return T{};
+        }
+        uint64_t value = 0;
+        for (size_t b=0; b<sizeof(T); b++) value |= (uint64_t)(unsigned char)data[offset++] << (8 * b);
+        return (T)value;
+    }
+    sista::Coordinates coordinates() {
+        unsigned short y = get<unsigned short>();
+        unsigned short x = get<unsigned short>();
+        if (!failed && (y >= worldHeight || x >= worldWidth)) failed = true;
+        return {y, x};
     }
-    // Some Eggs, randomly around the field
-    for (int i=0; i<15; i++) {
-        coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Egg::eggs.push_back(std::make_shared<Egg>(coordinates));
-            field->addPrintPawn(Egg::eggs.back());
-        }
+};
+
+template <typename T, typename F>
+void saveList(SnapshotWriter& out, const SlotMap<T>& entities, F fields) {
+    out.put((uint32_t)entities.size());
+    for (const std::shared_ptr<T>& entity : entities) {
+        out.put((Entity*)entity.get());
+        fields(entity.get());
     }
 }
+template <typename T, typename F>
+bool loadList(SnapshotReader& in, SlotMap<T>& entities, F make) {
+    uint32_t count = in.get<uint32_t>();
+    if (count > (uint32_t)worldWidth * worldHeight) return false;
+    for (uint32_t k=0; k<count && !in.failed; k++) {
+        sista::Coordinates coordinates = in.coordinates();
+        std::shared_ptr<T> entity = make(coordinates);
+        if (in.failed || !field->isFree(coordinates)) return false;
+        spawn(entities, entity);
+    }
+    return !in.failed;
+} // Entities are restored in iteration order, so the game goes on exactly as it would have
+
+bool saveGame(const char* path, uint32_t tick) {
+    SnapshotWriter out;
+    out.data.reserve(4096);
+    for (const char* c = SNAPSHOT_MAGIC; *c; c++) out.put(*c);
+    out.put((uint16_t)SNAPSHOT_VERSION);
+    out.put((uint16_t)worldWidth);
+    out.put((uint16_t)worldHeight);
+    out.put(tick);
+    out.put((uint8_t)day);
+    out.put(nextSwitch);
+    out.put(rng.seed);
+    for (Random* stream : {&rng.world, &rng.mobs, &rng.combat, &rng.player}) {
+        for (int w=0; w<4; w++) out.put(stream->state()[w]);
+    }
+    std::vector<uint32_t> chunks = field->generatedChunks();
+    out.put((uint32_t)chunks.size());
+    for (uint32_t chunk : chunks) out.put(chunk);
+
+    out.put((Entity*)Player::player.get());
+    out.put((uint8_t)Player::player->mode);
+    out.put(Player::player->inventory.walls);
+    out.put(Player::player->inventory.eggs);
+    out.put(Player::player->inventory.meat);
+
+    saveList(out, Wall::walls, [&](Wall* wall) { out.put(wall->strength); });
+    saveList(out, Gate::gates, [](Gate*) {});
+    saveList(out, Trap::traps, [](Trap*) {});
+    saveList(out, Mine::mines, [&](Mine* mine) { out.put((uint8_t)mine->triggered); });
+    saveList(out, Chest::chests, [&](Chest* chest) {
+        out.put(chest->inventory.walls);
+        out.put(chest->inventory.eggs);
+        out.put(chest->inventory.meat);
+    });
+    saveList(out, Bullet::bullets, [&](Bullet* bullet) {
+        out.put((uint8_t)bullet->direction);
+        out.put(bullet->speed);
+    });
+    saveList(out, EnemyBullet::enemyBullets, [&](EnemyBullet* enemyBullet) {
+        out.put((uint8_t)enemyBullet->direction);
+        out.put(enemyBullet->speed);
+    });
+    saveList(out, Walker::walkers, [](Walker*) {});
+    saveList(out, Archer::archers, [&](Archer* archer) { out.put(archer->shotTick); });
+    saveList(out, Chicken::chickens, [&](Chicken* chicken) { out.put(chicken->movesToEgg); });
+    saveList(out, Egg::eggs, [&](Egg* egg) { out.put(egg->hatchTick); });
+    saveList(out, Weasel::weasels, [&](Weasel* weasel) {
+        out.put((uint8_t)weasel->direction);
+        out.put((uint8_t)(weasel->crossed | weasel->caught << 1));
+    });
+    saveList(out, Snake::snakes, [&](Snake* snake) {
+        out.put((uint8_t)snake->direction);
+        out.put((uint8_t)snake->crossed);
+    });
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data.data(), out.data.size());
+    return (bool)file;
+}
+
+bool readSnapshotSize(const char* path, int& width, int& height) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data(10);
+    if (!file.read(data.data(), data.size())) return false;
+    SnapshotReader in{data};
+    for (const char* c = SNAPSHOT_MAGIC; *c; c++) {
+        if (in.get<char>() != *c) return false;
+    }
+    if (in.get<uint16_t>() != SNAPSHOT_VERSION) return false;
+    width = in.get<uint16_t>();
+    height = in.get<uint16_t>();
+    return width >= WIDTH && height >= HEIGHT && width <= MAX_WORLD_SIZE && height <= MAX_WORLD_SIZE;
+}
+
+bool loadGame(const char* path, uint32_t& tick) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    SnapshotReader in{data};
+    for (const char* c = SNAPSHOT_MAGIC; *c; c++) {
+        if (in.get<char>() != *c) return false;
+    }
+    if (in.get<uint16_t>() != SNAPSHOT_VERSION) return false;
+    if (in.get<uint16_t>() != worldWidth || in.get<uint16_t>() != worldHeight) return false;
+    tick = in.get<uint32_t>();
+    currentTick = tick ? tick - 1 : 0; // As if the ticks before had just been run
+    day = in.get<uint8_t>() != 0;
+    nextSwitch = in.get<uint32_t>();
+    if (nextSwitch < tick) return false;
+    rng.seed = in.get<uint64_t>();
+    for (Random* stream : {&rng.world, &rng.mobs, &rng.combat, &rng.player}) {
+        uint64_t state[4];
+        for (int w=0; w<4; w++) state[w] = in.get<uint64_t>();
+        stream->setState(state);
+    }
+    uint32_t chunks = in.get<uint32_t>();
+    if (chunks > (uint32_t)(field->chunkRows() * field->chunkColumns())) return false;
+    for (uint32_t k=0; k<chunks && !in.failed; k++) {
+        uint32_t chunk = in.get<uint32_t>();
+        if (chunk >= (uint32_t)(field->chunkRows() * field->chunkColumns())) return false;
+        field->generate(chunk / field->chunkColumns(), chunk % field->chunkColumns());
+    }
+    if (in.failed) return false;
 
-void repopulate(sista::SwappableField* field) {
     field->clear();
+    Wall::walls.clear(); Gate::gates.clear(); Trap::traps.clear(); Mine::mines.clear(); Chest::chests.clear();
+    Bullet::bullets.clear(); EnemyBullet::enemyBullets.clear(); Walker::walkers.clear(); Archer::archers.clear();
+    Chicken::chickens.clear(); Egg::eggs.clear(); Weasel::weasels.clear(); Snake::snakes.clear();
+    sista::Coordinates coordinates = in.coordinates();
+    if (in.failed || field->isOutOfBounds(coordinates) || !field->isFree(coordinates)) return false; // Its chunk must be in the list
+    Player::player = std::make_shared<Player>(coordinates);
+    uint8_t mode = in.get<uint8_t>();
+    if (mode > Player::Mode::HATCH) return false;
+    Player::player->mode = (Player::Mode)mode;
+    Player::player->inventory.walls = in.get<short>();
+    Player::player->inventory.eggs = in.get<short>();
+    Player::player->inventory.meat = in.get<short>();
+    if (in.failed) return false;
     field->addPrintPawn(Player::player);
-    for (auto wall : Wall::walls) {
-        field->addPrintPawn(wall);
+    applyDaylight();
+
+    return loadList(in, Wall::walls, [&](sista::Coordinates coordinates) {
+        return makePooled<Wall>(coordinates, in.get<short>());
+    }) && loadList(in, Gate::gates, [](sista::Coordinates coordinates) {
+        return makePooled<Gate>(coordinates);
+    }) && loadList(in, Trap::traps, [](sista::Coordinates coordinates) {
+        return makePooled<Trap>(coordinates);
+    }) && loadList(in, Mine::mines, [&](sista::Coordinates coordinates) {
+        auto mine = makePooled<Mine>(coordinates);
+        uint8_t flags = in.get<uint8_t>();
+        mine->triggered = flags & 1;
+        return mine;
+    }) && loadList(in, Chest::chests, [&](sista::Coordinates coordinates) {
+        Inventory inventory;
+        inventory.walls = in.get<short>();
+        inventory.eggs = in.get<short>();
+        inventory.meat = in.get<short>();
+        if (inventory.walls < 0 || inventory.eggs < 0 || inventory.meat < 0) in.failed = true;
+        return makePooled<Chest>(coordinates, inventory);
+    }) && loadList(in, Bullet::bullets, [&](sista::Coordinates coordinates) {
+        Direction direction = (Direction)(in.get<uint8_t>() & 3);
+        unsigned short speed = in.get<unsigned short>();
+        if (speed == 0 || speed > MAX_WORLD_SIZE) in.failed = true; // A still bullet would never leave its cell
+        return makePooled<Bullet>(coordinates, direction, speed);
+    }) && loadList(in, EnemyBullet::enemyBullets, [&](sista::Coordinates coordinates) {
+        Direction direction = (Direction)(in.get<uint8_t>() & 3);
+        unsigned short speed = in.get<unsigned short>();
+        if (speed == 0 || speed > MAX_WORLD_SIZE) in.failed = true;
+        return makePooled<EnemyBullet>(coordinates, direction, speed);
+    }) && loadList(in, Walker::walkers, [](sista::Coordinates coordinates) {
+        return makePooled<Walker>(coordinates);
+    }) && loadList(in, Archer::archers, [&](sista::Coordinates coordinates) {
+        auto archer = makePooled<Archer>(coordinates);
+        archer->shotTick = in.get<uint32_t>();
+        if (archer->shotTick < tick) in.failed = true; // The timer wheel would drop it, and the archer never shoot again
+        return archer;
+    }) && loadList(in, Chicken::chickens, [&](sista::Coordinates coordinates) {
+        auto chicken = makePooled<Chicken>(coordinates);
+        chicken->movesToEgg = in.get<uint32_t>();
+        return chicken;
+    }) && loadList(in, Egg::eggs, [&](sista::Coordinates coordinates) {
+        auto egg = makePooled<Egg>(coordinates);
+        egg->hatchTick = in.get<uint32_t>();
+        if (egg->hatchTick < tick) in.failed = true;
+        return egg;
+    }) && loadList(in, Weasel::weasels, [&](sista::Coordinates coordinates) {
+        auto weasel = makePooled<Weasel>(coordinates, (Direction)(in.get<uint8_t>() & 3));
+        uint8_t flags = in.get<uint8_t>();
+        weasel->crossed = flags & 1;
+        weasel->caught = flags & 2;
+        return weasel;
+    }) && loadList(in, Snake::snakes, [&](sista::Coordinates coordinates) {
+        auto snake = makePooled<Snake>(coordinates, (Direction)(in.get<uint8_t>() & 3));
+        snake->crossed = in.get<uint8_t>() != 0;
+        return snake;
+    }) && in.offset == data.size();
+}
+
+void lose(const char* reason) {
+    end = true;
+    deathMessage = reason;
+}
+
+FrameBuffer::FrameBuffer(size_t capacity) : buffer(capacity) {
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+int FrameBuffer::overflow(int c) {
+    // Only grows during the first big frames, then the buffer is reused as it is
+    std::ptrdiff_t used = pptr() - pbase();
+    buffer.resize(buffer.size() * 2);
+    setp(buffer.data(), buffer.data() + buffer.size());
+    pbump((int)used);
+    if (c != traits_type::eof()) {
+        *pptr() = (char)c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+void FrameBuffer::send() {
+    const char* data = pbase();
+    size_t size = pptr() - pbase();
+    bytes = size;
+    writes = 0;
+    #if defined(_WIN32)
+        fwrite(data, 1, size, stdout);
+        fflush(stdout);
+        writes = 1;
+    #else
+        while (size > 0) {
+            ssize_t written = ::write(STDOUT_FILENO, data, size);
+            writes++;
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break; // The terminal is gone, drop the frame
+            }
+            data += written;
+            size -= written;
+        }
+    #endif
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+Renderer::Renderer(int width, int height) : width(width), height(height), front(width * height), back(width * height), terminal(std::cout.rdbuf()), frame(FRAME_CAPACITY) {
+    std::flush(std::cout); // What was printed before goes out before the first frame
+}
+void Renderer::mute() {
+    std::cout.rdbuf(&nullBuffer);
+}
+void Renderer::unmute() {
+    std::cout.rdbuf(&frame);
+}
+void Renderer::send() {
+    std::flush(std::cout);
+    frame.send();
+}
+void Renderer::restore() {
+    std::cout.rdbuf(terminal);
+}
+void Renderer::follow(sista::Coordinates target) {
+    origin.y = (unsigned short)std::clamp((int)target.y - height / 2, 0, worldHeight - height);
+    origin.x = (unsigned short)std::clamp((int)target.x - width / 2, 0, worldWidth - width);
+}
+void Renderer::capture() {
+    for (unsigned short y=0; y<height; y++) {
+        for (unsigned short x=0; x<width; x++) {
+            Cell& cell = back[y * width + x];
+            unsigned short worldY = origin.y + y, worldX = origin.x + x;
+            if (field->typeAt(worldY, worldX) == Type::EMPTY) {
+                cell = Cell{};
+                continue;
+            }
+            Entity* pawn = (Entity*)field->getPawn(worldY, worldX);
+            const sista::ANSISettings& style = pawn->style();
+            cell = Cell{pawn->glyph(), style.foregroundColor, style.backgroundColor, style.attribute};
+        }
+    }
+}
+void Renderer::resync() {
+    sista::clearScreen();
+    printBorder(height, width);
+    std::fill(front.begin(), front.end(), Cell{}); // The viewport is blank now, present() fills it
+    present();
+}
+void Renderer::present() {
+    capture();
+    const Cell* style = nullptr; // Last style applied, to skip repeating it
+    int cursorY = -1, cursorX = -1; // Where the terminal cursor is after the last write
+    for (unsigned short y=0; y<height; y++) {
+        for (unsigned short x=0; x<width; x++) {
+            const Cell& cell = back[y * width + x];
+            if (cell == front[y * width + x]) continue;
+            if (y != cursorY || x != cursorX) {
+                cursor.goTo(y, x);
+            }
+            if (style == nullptr || !cell.sameStyle(*style)) {
+                sista::resetAnsi();
+                if (cell != Cell{}) {
+                    sista::ANSISettings{cell.foreground, cell.background, cell.attribute}.apply();
+                }
+                style = &cell;
+            }
+            std::cout << cell.symbol;
+            front[y * width + x] = cell;
+            cursorY = y;
+            cursorX = x + 1;
+        }
+    }
+    sista::resetAnsi();
+}
+
+void populate(World* field) {
+    // Walls, some randomly around the field and some in a row
+    sista::Coordinates coordinates;
+    for (int j=0; j<5; j++) {
+        int length = rng.world.below(HEIGHT - 10) + 1;
+        int start_column = rng.world.below(worldWidth - length);
+        int row = rng.world.below(worldHeight - 10);
+        for (int i=0; i<length; i++) {
+            coordinates = {row, start_column + i};
+            if (field->isFree(coordinates)) {
+                spawn(Wall::walls, makePooled<Wall>(coordinates, rng.world.below(2) + 1));
+            }
+        }
+    }
+    auto freeCell = [&](sista::Coordinates& coordinates) {
+        return field->randomFreeCell(0, 0, worldHeight, worldWidth, rng.world, coordinates);
+    };
+    for (int i=0; i<HEIGHT; i++) {
+        if (freeCell(coordinates)) {
+            spawn(Wall::walls, makePooled<Wall>(coordinates, rng.world.below(2) + 1));
+        }
+    }
+    // Chests, a couple of them
+    for (int i=0; i<3; i++) {
+        if (freeCell(coordinates)) {
+            spawn(Chest::chests, makePooled<Chest>(coordinates, Inventory{(short)rng.world.below(5), (short)rng.world.below(5), 0}, true));
+        }
+    }
+    // Walkers, some randomly around the field, but none of them in a 5x5 square around the player, which starts in {0, 0}
+    for (int i=0; i<5; i++) {
+        if (freeCell(coordinates) && coordinates.y > 5 && coordinates.x > 5) {
+            spawn(Walker::walkers, makePooled<Walker>(coordinates));
+        }
+    }
+    // Archers, some randomly around the field, but none in the same row or column as the player
+    for (int i=0; i<5; i++) {
+        if (freeCell(coordinates) && coordinates.y >= 5 && coordinates.x >= 5) {
+            spawn(Archer::archers, makePooled<Archer>(coordinates));
+        }
+    }
+    // Only one Weasel, to be generated from the left side of the field
+    coordinates = {rng.world.below(worldHeight), 0};
+    if (field->isFree(coordinates)) {
+        spawn(Weasel::weasels, makePooled<Weasel>(coordinates, Direction::RIGHT));
+    }
+    // Only one Snake, to be generated from the right side of the field
+    coordinates = {rng.world.below(worldHeight - 10), worldWidth - 1};
+    if (field->isFree(coordinates)) {
+        spawn(Snake::snakes, makePooled<Snake>(coordinates, Direction::LEFT));
+    }
+    // Some Chickens, randomly around the field
+    for (int i=0; i<5; i++) {
+        if (freeCell(coordinates)) {
+            spawn(Chicken::chickens, makePooled<Chicken>(coordinates));
+        }
+    }
+    // Some Eggs, randomly around the field
+    for (int i=0; i<15; i++) {
+        if (freeCell(coordinates)) {
+            spawn(Egg::eggs, makePooled<Egg>(coordinates));
+        }
+    }
+}
+
+void populateChunk(World* field, int chunkY, int chunkX, sista::Coordinates keepClear) {
+    // Same recipe as populate(), with the amounts scaled to the area of the chunk
+    int top = chunkY * CHUNK_SIZE, left = chunkX * CHUNK_SIZE;
+    int height = std::min(CHUNK_SIZE, worldHeight - top), width = std::min(CHUNK_SIZE, worldWidth - left);
+    auto share = [&](int amount) { return (amount * height * width + WIDTH * HEIGHT - 1) / (WIDTH * HEIGHT); };
+    auto freeCell = [&](sista::Coordinates& coordinates) {
+        return field->randomFreeCell(top, left, height, width, rng.world, coordinates);
+    };
+    auto farFromPlayer = [&](sista::Coordinates coordinates) {
+        return std::abs(coordinates.y - keepClear.y) > 5 || std::abs(coordinates.x - keepClear.x) > 5;
+    };
+    sista::Coordinates coordinates;
+    for (int j=0; j<share(5); j++) {
+        int length = rng.world.below(std::max(1, width * 2 / 3)) + 1;
+        int start_column = left + rng.world.below(width - length + 1);
+        int row = top + rng.world.below(height);
+        for (int i=0; i<length; i++) {
+            coordinates = {row, start_column + i};
+            if (field->isFree(coordinates) && coordinates != keepClear) {
+                spawn(Wall::walls, makePooled<Wall>(coordinates, rng.world.below(2) + 1));
+            }
+        }
     }
-    for (auto chest : Chest::chests) {
+    for (int i=0; i<share(HEIGHT); i++) {
+        if (freeCell(coordinates) && coordinates != keepClear) {
+            spawn(Wall::walls, makePooled<Wall>(coordinates, rng.world.below(2) + 1));
+        }
+    }
+    for (int i=0; i<share(3); i++) {
+        if (freeCell(coordinates) && coordinates != keepClear) {
+            spawn(Chest::chests, makePooled<Chest>(coordinates, Inventory{(short)rng.world.below(5), (short)rng.world.below(5), 0}, true));
+        }
+    }
+    for (int i=0; i<share(5); i++) {
+        if (freeCell(coordinates) && farFromPlayer(coordinates)) {
+            spawn(Walker::walkers, makePooled<Walker>(coordinates));
+        }
+    }
+    for (int i=0; i<share(5); i++) {
+        if (freeCell(coordinates) && farFromPlayer(coordinates)) {
+            spawn(Archer::archers, makePooled<Archer>(coordinates));
+        }
+    }
+    for (int i=0; i<share(5); i++) {
+        if (freeCell(coordinates) && coordinates != keepClear) {
+            spawn(Chicken::chickens, makePooled<Chicken>(coordinates));
+        }
+    }
+    for (int i=0; i<share(15); i++) {
+        if (freeCell(coordinates) && coordinates != keepClear) {
+            spawn(Egg::eggs, makePooled<Egg>(coordinates));
+        }
+    }
+}
+
+void generateAround(World* field, sista::Coordinates center) {
+    if (!field->lazy) return;
+    int chunkY = center.y >> CHUNK_SHIFT, chunkX = center.x >> CHUNK_SHIFT;
+    int top = std::max(0, chunkY - GENERATION_RADIUS), bottom = std::min(field->chunkRows() - 1, chunkY + GENERATION_RADIUS);
+    int left = std::max(0, chunkX - GENERATION_RADIUS), right = std::min(field->chunkColumns() - 1, chunkX + GENERATION_RADIUS);
+    for (int y=top; y<=bottom; y++) {
+        for (int x=left; x<=right; x++) {
+            if (field->generate(y, x)) {
+                populateChunk(field, y, x, center);
+            }
+        }
+    }
+    field->activeTop = top * CHUNK_SIZE;
+    field->activeLeft = left * CHUNK_SIZE;
+    field->activeHeight = std::min(worldHeight, (bottom + 1) * CHUNK_SIZE) - field->activeTop;
+    field->activeWidth = std::min(worldWidth, (right + 1) * CHUNK_SIZE) - field->activeLeft;
+}
+
+void repopulate(World* field) {
+    field->clear();
+    field->addPrintPawn(Player::player);
+    for (const auto& wall : Wall::walls) {
+        field->addPrintPawn(wall);
+    }
+    for (const auto& chest : Chest::chests) {
         field->addPrintPawn(chest);
     }
-    for (auto mine : Mine::mines) {
+    for (const auto& mine : Mine::mines) {
         field->addPrintPawn(mine);
     }
-    for (auto trap : Trap::traps) {
+    for (const auto& trap : Trap::traps) {
         field->addPrintPawn(trap);
     }
-    for (auto gate : Gate::gates) {
+    for (const auto& gate : Gate::gates) {
         field->addPrintPawn(gate);
     }
-    for (auto weasel : Weasel::weasels) {
+    for (const auto& weasel : Weasel::weasels) {
         field->addPrintPawn(weasel);
     }
-    for (auto snake : Snake::snakes) {
+    for (const auto& snake : Snake::snakes) {
         field->addPrintPawn(snake);
     }
-    for (auto chicken : Chicken::chickens) {
+    for (const auto& chicken : Chicken::chickens) {
         field->addPrintPawn(chicken);
     }
-    for (auto egg : Egg::eggs) {
+    for (const auto& egg : Egg::eggs) {
         field->addPrintPawn(egg);
     }
-    for (auto bullet : Bullet::bullets) {
+    for (const auto& bullet : Bullet::bullets) {
         field->addPrintPawn(bullet);
     }
-    for (auto enemyBullet : EnemyBullet::enemyBullets) {
+    for (const auto& enemyBullet : EnemyBullet::enemyBullets) {
         field->addPrintPawn(enemyBullet);
     }
-    for (auto walker : Walker::walkers) {
+    for (const auto& walker : Walker::walkers) {
         field->addPrintPawn(walker);
     }
-    for (auto archer : Archer::archers) {
+    for (const auto& archer : Archer::archers) {
         field->addPrintPawn(archer);
     }
 }
 
-void spawnNew(sista::SwappableField* field) {
-    if (walkerSpawnDistribution(rng)) {
-        sista::Coordinates coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Walker::walkers.push_back(std::make_shared<Walker>(coordinates));
-            field->addPrintPawn(Walker::walkers.back());
-        }
+void spawnNew(World* field) {
+    // In the generated area around the player, which is the whole world unless it is generated lazily
+    // Picked among the free cells, so a crowded field spawns as much as an empty one
+    auto freeCell = [&](sista::Coordinates& coordinates) {
+        return field->randomFreeCell(field->activeTop, field->activeLeft, field->activeHeight, field->activeWidth, rng.world, coordinates);
+    };
+    sista::Coordinates coordinates;
+    if (walkerSpawnDistribution(rng.world) && freeCell(coordinates)) {
+        spawn(Walker::walkers, makePooled<Walker>(coordinates));
     }
-    if (archerSpawnDistribution(rng)) {
-        sista::Coordinates coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Archer::archers.push_back(std::make_shared<Archer>(coordinates));
-            field->addPrintPawn(Archer::archers.back());
-        }
+    if (archerSpawnDistribution(rng.world) && freeCell(coordinates)) {
+        spawn(Archer::archers, makePooled<Archer>(coordinates));
     }
-    if (weaselSpawnDistribution(rng)) {
-        sista::Coordinates coordinates = {rand() % HEIGHT, 0};
+    // Weasels and snakes come in from the sides, they still give up when their cell is taken
+    if (weaselSpawnDistribution(rng.world)) {
+        coordinates = {field->activeTop + rng.world.below(field->activeHeight), field->activeLeft};
         if (field->isFree(coordinates)) {
-            Weasel::weasels.push_back(std::make_shared<Weasel>(coordinates, Direction::RIGHT));
-            field->addPrintPawn(Weasel::weasels.back());
+            spawn(Weasel::weasels, makePooled<Weasel>(coordinates, Direction::RIGHT));
         }
     }
-    if (snakeSpawnDistribution(rng)) {
-        sista::Coordinates coordinates = {rand() % (HEIGHT - 10), WIDTH - 1};
+    if (snakeSpawnDistribution(rng.world)) {
+        coordinates = {field->activeTop + rng.world.below(field->activeHeight - 10), field->activeLeft + field->activeWidth - 1};
         if (field->isFree(coordinates)) {
-            Snake::snakes.push_back(std::make_shared<Snake>(coordinates, Direction::LEFT));
-            field->addPrintPawn(Snake::snakes.back());
+            spawn(Snake::snakes, makePooled<Snake>(coordinates, Direction::LEFT));
         }
     }
-    if (wallSpawnDistribution(rng)) {
-        sista::Coordinates coordinates = {rand() % HEIGHT, rand() % WIDTH};
-        if (field->isFree(coordinates)) {
-            Wall::walls.push_back(std::make_shared<Wall>(coordinates, 3));
-            field->addPrintPawn(Wall::walls.back());
-        }
+    if (wallSpawnDistribution(rng.world) && freeCell(coordinates)) {
+        spawn(Wall::walls, makePooled<Wall>(coordinates, 3));
     }
 }
 
@@ -1115,7 +1810,352 @@ std::unordered_map<Direction, char> directionSymbol = {
     {Direction::DOWN, 'v'},
     {Direction::LEFT, '<'}
 };
-std::mt19937 rng(std::chrono::system_clock::now().time_since_epoch().count());
+RandomStreams rng;
+
+
+Chunk::Chunk() {
+    types.fill((uint8_t)Type::EMPTY);
+    watchers.fill(0);
+    rowSight.fill(0);
+    columnSight.fill(0);
+}
+
+World::World(int width, int height, bool lazy) : width(width), height(height), chunksWide((width + CHUNK_SIZE - 1) / CHUNK_SIZE), chunksHigh((height + CHUNK_SIZE - 1) / CHUNK_SIZE), chunks(chunksWide * chunksHigh), lazy(lazy), activeHeight(height), activeWidth(width) {
+    if (lazy) return;
+    for (int y=0; y<chunksHigh; y++) {
+        for (int x=0; x<chunksWide; x++) {
+            generate(y, x);
+        }
+    }
+}
+Chunk* World::chunkAt(unsigned short y, unsigned short x) const {
+    if (y >= height || x >= width) return nullptr;
+    return chunks[(y >> CHUNK_SHIFT) * chunksWide + (x >> CHUNK_SHIFT)].get();
+}
+Type World::typeAt(sista::Coordinates coordinates) const {
+    return typeAt(coordinates.y, coordinates.x);
+}
+Type World::typeAt(unsigned short y, unsigned short x) const {
+    Chunk* chunk = chunkAt(y, x);
+    return chunk ? (Type)chunk->types[cellIndex(y, x)] : Type::EMPTY;
+}
+sista::Pawn* World::getPawn(sista::Coordinates& coordinates) const {
+    return getPawn(coordinates.y, coordinates.x);
+}
+sista::Pawn* World::getPawn(unsigned short y, unsigned short x) const {
+    Chunk* chunk = chunkAt(y, x);
+    return chunk ? chunk->pawns[cellIndex(y, x)].get() : nullptr;
+}
+bool World::isOutOfBounds(sista::Coordinates& coordinates) const {
+    return chunkAt(coordinates.y, coordinates.x) == nullptr;
+}
+bool World::isOutOfBounds(unsigned short y, unsigned short x) const {
+    return chunkAt(y, x) == nullptr;
+}
+bool World::isOccupied(sista::Coordinates& coordinates) const {
+    return getPawn(coordinates) != nullptr;
+}
+bool World::isFree(sista::Coordinates& coordinates) const {
+    return isFree(coordinates.y, coordinates.x);
+}
+bool World::isFree(unsigned short y, unsigned short x) const {
+    Chunk* chunk = chunkAt(y, x);
+    return chunk && chunk->pawns[cellIndex(y, x)] == nullptr;
+}
+int World::watchersAt(unsigned short y, unsigned short x) const {
+    Chunk* chunk = chunkAt(y, x);
+    return chunk ? chunk->watchers[cellIndex(y, x)] : 0;
+}
+void World::watch(sista::Coordinates coordinates, int delta, Chunk* only) {
+    for (int j=-1; j<=1; j++) {
+        for (int i=-1; i<=1; i++) {
+            Chunk* chunk = chunkAt(coordinates.y + j, coordinates.x + i);
+            if (chunk && (only == nullptr || chunk == only)) chunk->watchers[cellIndex(coordinates.y + j, coordinates.x + i)] += delta;
+        }
+    }
+}
+// Each chunk belongs to a single region, so the mobs updated in parallel never mark the same chunk
+void World::markFree(Chunk* chunk, int cell, bool free) {
+    uint64_t bit = 1ULL << (cell % 64);
+    uint64_t& word = chunk->freeCells[cell / 64];
+    if (bool(word & bit) == free) return;
+    word ^= bit;
+    chunk->freeCount += free ? 1 : -1;
+}
+void World::resetFree(int index) {
+    Chunk* chunk = chunks[index].get();
+    int top = index / chunksWide * CHUNK_SIZE, left = index % chunksWide * CHUNK_SIZE;
+    chunk->freeCells.fill(0);
+    chunk->freeCount = 0;
+    for (int y=top; y<std::min(top + CHUNK_SIZE, height); y++) {
+        for (int x=left; x<std::min(left + CHUNK_SIZE, width); x++) {
+            if (chunk->pawns[cellIndex(y, x)] == nullptr) markFree(chunk, cellIndex(y, x), true);
+        }
+    }
+}
+// The free cells are picked by rank in a fixed order, so the choice only depends on what is on the field
+// and a loaded game picks the same cells as the one that was saved
+bool World::randomFreeCell(int top, int left, int height, int width, Random& random, sista::Coordinates& coordinates) const {
+    int chunkTop = top >> CHUNK_SHIFT, chunkBottom = (top + height - 1) >> CHUNK_SHIFT;
+    int chunkLeft = left >> CHUNK_SHIFT, chunkRight = (left + width - 1) >> CHUNK_SHIFT;
+    uint32_t total = 0;
+    for (int y=chunkTop; y<=chunkBottom; y++) {
+        for (int x=chunkLeft; x<=chunkRight; x++) {
+            if (chunks[y * chunksWide + x]) total += chunks[y * chunksWide + x]->freeCount;
+        }
+    }
+    if (total == 0) return false;
+    uint32_t rank = random.below(total);
+    for (int y=chunkTop; y<=chunkBottom; y++) {
+        for (int x=chunkLeft; x<=chunkRight; x++) {
+            Chunk* chunk = chunks[y * chunksWide + x].get();
+            if (!chunk) continue;
+            if (rank >= (uint32_t)chunk->freeCount) {
+                rank -= chunk->freeCount;
+                continue;
+            }
+            for (size_t w=0; w<chunk->freeCells.size(); w++) {
+                uint64_t word = chunk->freeCells[w];
+                uint32_t count = __builtin_popcountll(word);
+                if (rank >= count) {
+                    rank -= count;
+                    continue;
+                }
+                for (; rank > 0; rank--) word &= word - 1; // Drops the lowest set bits
+                int cell = w * 64 + __builtin_ctzll(word);
+                coordinates = sista::Coordinates(y * CHUNK_SIZE + cell / CHUNK_SIZE, x * CHUNK_SIZE + cell % CHUNK_SIZE);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+void World::sight(sista::Coordinates coordinates, Type type, bool blocking) {
+    if (type != Type::WALL && type != Type::GATE) return;
+    Chunk* chunk = chunkAt(coordinates.y, coordinates.x);
+    uint32_t& row = chunk->rowSight[coordinates.y & (CHUNK_SIZE - 1)];
+    uint32_t& column = chunk->columnSight[coordinates.x & (CHUNK_SIZE - 1)];
+    if (blocking) {
+        row |= 1U << (coordinates.x & (CHUNK_SIZE - 1));
+        column |= 1U << (coordinates.y & (CHUNK_SIZE - 1));
+    } else {
+        row &= ~(1U << (coordinates.x & (CHUNK_SIZE - 1)));
+        column &= ~(1U << (coordinates.y & (CHUNK_SIZE - 1)));
+    }
+}
+// Bits of a sight word from first to last included, or to the end of the chunk of first if last is beyond it
+static uint32_t sightMask(int first, int last) {
+    int from = first & (CHUNK_SIZE - 1), to = std::min(last, first | (CHUNK_SIZE - 1)) & (CHUNK_SIZE - 1);
+    return (~0U << from) & (~0U >> (31 - to));
+}
+// A word per chunk crossed, the ones not generated yet have nothing in the way
+bool World::clearLine(sista::Coordinates from, sista::Coordinates to) const {
+    if (from.y == to.y) {
+        int first = std::min(from.x, to.x) + 1, last = std::max(from.x, to.x) - 1;
+        for (int x=first; x<=last; x=(x | (CHUNK_SIZE - 1)) + 1) {
+            Chunk* chunk = chunkAt(from.y, x);
+            if (chunk && (chunk->rowSight[from.y & (CHUNK_SIZE - 1)] & sightMask(x, last))) return false;
+        }
+        return true;
+    }
+    if (from.x == to.x) {
+        int first = std::min(from.y, to.y) + 1, last = std::max(from.y, to.y) - 1;
+        for (int y=first; y<=last; y=(y | (CHUNK_SIZE - 1)) + 1) {
+            Chunk* chunk = chunkAt(y, from.x);
+            if (chunk && (chunk->columnSight[from.x & (CHUNK_SIZE - 1)] & sightMask(y, last))) return false;
+        }
+        return true;
+    }
+    return false;
+}
+void World::arrive(sista::Pawn* pawn) {
+    Type type = ((Entity*)pawn)->type;
+    sista::Coordinates coordinates = pawn->getCoordinates();
+    if (type == Type::MINE) {
+        // A mine laid next to a walker or an archer is triggered right away, as if they had just arrived
+        watch(coordinates, +1);
+        for (int j=-1; j<=1; j++) {
+            for (int i=-1; i<=1; i++) {
+                Type neighbor = typeAt(coordinates.y + j, coordinates.x + i);
+                if (neighbor == Type::WALKER || neighbor == Type::ARCHER) {
+                    ((Mine*)pawn)->trigger();
+                    return;
+                }
+            }
+        }
+        return;
+    }
+    if (type != Type::WALKER && type != Type::ARCHER) return;
+    if (watchersAt(coordinates.y, coordinates.x) == 0) return; // The usual case, no mine around
+    for (int j=-1; j<=1; j++) {
+        for (int i=-1; i<=1; i++) {
+            if (typeAt(coordinates.y + j, coordinates.x + i) == Type::MINE) {
+                ((Mine*)getPawn(coordinates.y + j, coordinates.x + i))->trigger();
+            }
+        }
+    }
+}
+void World::addPrintPawn(std::shared_ptr<sista::Pawn> pawn) {
+    sista::Coordinates coordinates = pawn->getCoordinates();
+    Chunk* chunk = chunkAt(coordinates.y, coordinates.x);
+    int cell = cellIndex(coordinates.y, coordinates.x);
+    chunk->types[cell] = ((Entity*)pawn.get())->type;
+    chunk->pawns[cell] = std::move(pawn);
+    markFree(chunk, cell, false);
+    if (!FlowField::passable((Type)chunk->types[cell])) blockers++;
+    sight(coordinates, (Type)chunk->types[cell], true);
+    arrive(chunk->pawns[cell].get());
+    if (printing) chunk->pawns[cell]->print();
+}
+void World::movePawn(sista::Pawn* pawn, sista::Coordinates& coordinates) {
+    sista::Coordinates previous = pawn->getCoordinates();
+    Chunk* from = chunkAt(previous.y, previous.x);
+    Chunk* to = chunkAt(coordinates.y, coordinates.x);
+    int fromCell = cellIndex(previous.y, previous.x);
+    int toCell = cellIndex(coordinates.y, coordinates.x);
+    to->pawns[toCell] = std::move(from->pawns[fromCell]);
+    to->types[toCell] = from->types[fromCell];
+    from->types[fromCell] = (uint8_t)Type::EMPTY;
+    markFree(from, fromCell, true);
+    markFree(to, toCell, false);
+    if (to->types[toCell] == (uint8_t)Type::MINE) watch(previous, -1);
+    if (!FlowField::passable((Type)to->types[toCell])) blockers++;
+    sight(previous, (Type)to->types[toCell], false);
+    sight(coordinates, (Type)to->types[toCell], true);
+    pawn->setCoordinates(coordinates);
+    arrive(pawn);
+    if (printing) {
+        sista::resetAnsi();
+        cursor.goTo(previous);
+        std::cout << ' ';
+        pawn->print();
+    }
+}
+void World::erasePawn(sista::Pawn* pawn) {
+    sista::Coordinates coordinates = pawn->getCoordinates();
+    Chunk* chunk = chunkAt(coordinates.y, coordinates.x);
+    int cell = cellIndex(coordinates.y, coordinates.x);
+    if (printing) {
+        sista::resetAnsi();
+        cursor.goTo(coordinates);
+        std::cout << ' ';
+    }
+    if (chunk->types[cell] == (uint8_t)Type::MINE) watch(coordinates, -1);
+    if (!FlowField::passable((Type)chunk->types[cell])) blockers++;
+    sight(coordinates, (Type)chunk->types[cell], false);
+    chunk->types[cell] = (uint8_t)Type::EMPTY;
+    markFree(chunk, cell, true);
+    chunk->pawns[cell].reset(); // Last, as it may destroy the pawn
+}
+void World::rePrintPawn(sista::Pawn* pawn) {
+    if (printing) pawn->print();
+}
+void World::swapTwoPawns(sista::Pawn* first, sista::Pawn* second) {
+    sista::Coordinates a = first->getCoordinates();
+    sista::Coordinates b = second->getCoordinates();
+    Chunk* chunkA = chunkAt(a.y, a.x);
+    Chunk* chunkB = chunkAt(b.y, b.x);
+    int cellA = cellIndex(a.y, a.x);
+    int cellB = cellIndex(b.y, b.x);
+    std::swap(chunkA->pawns[cellA], chunkB->pawns[cellB]);
+    std::swap(chunkA->types[cellA], chunkB->types[cellB]);
+    sight(a, (Type)chunkB->types[cellB], false); // What was in a is now in b
+    sight(b, (Type)chunkA->types[cellA], false);
+    sight(a, (Type)chunkA->types[cellA], true);
+    sight(b, (Type)chunkB->types[cellB], true);
+    first->setCoordinates(b);
+    second->setCoordinates(a);
+    arrive(first);
+    arrive(second);
+    if (printing) {
+        first->print();
+        second->print();
+    }
+}
+void World::print() {
+    for (const std::unique_ptr<Chunk>& chunk : chunks) {
+        if (!chunk) continue;
+        for (const std::shared_ptr<sista::Pawn>& pawn : chunk->pawns) {
+            if (pawn) pawn->print();
+        }
+    }
+}
+void World::clear() {
+    for (size_t i=0; i<chunks.size(); i++) {
+        Chunk* chunk = chunks[i].get();
+        if (!chunk) continue;
+        chunk->types.fill((uint8_t)Type::EMPTY);
+        chunk->watchers.fill(0);
+        for (std::shared_ptr<sista::Pawn>& pawn : chunk->pawns) pawn.reset();
+        chunk->rowSight.fill(0);
+        chunk->columnSight.fill(0);
+        resetFree(i);
+    }
+}
+bool World::generate(int chunkY, int chunkX) {
+    std::unique_ptr<Chunk>& chunk = chunks[chunkY * chunksWide + chunkX];
+    if (chunk) return false;
+    chunk = std::make_unique<Chunk>();
+    resetFree(chunkY * chunksWide + chunkX);
+    blockers++; // Cells that were outside of the world are now free
+    // Mines just outside, in chunks generated earlier, also watch the border of this one; their own chunks were counted already
+    int top = chunkY * CHUNK_SIZE - 1, left = chunkX * CHUNK_SIZE - 1;
+    for (int y=top; y<=top+CHUNK_SIZE+1; y++) {
+        for (int x=left; x<=left+CHUNK_SIZE+1; x++) {
+            bool ring = y == top || y == top+CHUNK_SIZE+1 || x == left || x == left+CHUNK_SIZE+1;
+            if (ring && typeAt(y, x) == Type::MINE) watch(sista::Coordinates(y, x), +1, chunk.get());
+        }
+    }
+    return true;
+}
+std::vector<uint32_t> World::generatedChunks() const {
+    std::vector<uint32_t> indices;
+    for (size_t i=0; i<chunks.size(); i++) {
+        if (chunks[i]) indices.push_back((uint32_t)i);
+    }
+    return indices;
+}
+
+bool FlowField::passable(Type type) {
+    return type != Type::WALL && type != Type::GATE && type != Type::CHEST && type != Type::TRAP && type != Type::MINE;
+}
+void FlowField::update(World* world, sista::Coordinates player) {
+    uint32_t blockers = world->blockers.load(std::memory_order_relaxed);
+    if (computed && player == source && blockers == seen) return;
+    computed = true;
+    source = player;
+    seen = blockers;
+    size = 2 * FLOW_RADIUS + 1;
+    top = (int)player.y - FLOW_RADIUS;
+    left = (int)player.x - FLOW_RADIUS;
+    distance.assign(size * size, UNREACHABLE);
+    frontier.clear();
+    uint32_t center = FLOW_RADIUS * size + FLOW_RADIUS;
+    distance[center] = 0;
+    frontier.push_back(center);
+    const int dy[] = {-1, 0, 1, 0};
+    const int dx[] = {0, 1, 0, -1};
+    for (size_t k=0; k<frontier.size(); k++) {
+        int y = frontier[k] / size;
+        int x = frontier[k] % size;
+        for (int d=0; d<4; d++) {
+            int ny = y + dy[d], nx = x + dx[d];
+            if (ny < 0 || nx < 0 || ny >= size || nx >= size) continue;
+            int wy = top + ny, wx = left + nx;
+            if (wy < 0 || wx < 0 || world->isOutOfBounds(wy, wx)) continue;
+            uint32_t next = ny * size + nx;
+            if (distance[next] != UNREACHABLE || !passable(world->typeAt(wy, wx))) continue;
+            distance[next] = distance[frontier[k]] + 1;
+            frontier.push_back(next);
+        }
+    }
+}
+uint16_t FlowField::at(sista::Coordinates coordinates) const {
+    int y = (int)coordinates.y - top;
+    int x = (int)coordinates.x - left;
+    if (y < 0 || x < 0 || y >= size || x >= size) return UNREACHABLE;
+    return distance[y * size + x];
+}
 
 
 void Inventory::operator+=(const Inventory& other) {
@@ -1137,35 +2177,45 @@ sista::ANSISettings nightPlayerStyle = {
     sista::BackgroundColor::BLACK,
     sista::Attribute::REVERSE
 };
-Player::Player(sista::Coordinates coordinates) : Entity('$', coordinates, playerStyle, Type::PLAYER), mode(Player::Mode::COLLECT), inventory({0, 0, 0}) {}
-Player::Player() : Entity('$', {0, 0}, playerStyle, Type::PLAYER), mode(Player::Mode::COLLECT), inventory({0, 0, 0}) {}
+Player::Player(sista::Coordinates coordinates) : Entity('$', coordinates, playerStyle, Type::PLAYER), mode(Player::Mode::COLLECT), inventory({0, 0, 0}) {
+    registered = true; // Tracked by Player::player
+}
+Player::Player() : Entity('$', {0, 0}, playerStyle, Type::PLAYER), mode(Player::Mode::COLLECT), inventory({0, 0, 0}) {
+    registered = true;
+}
 void Player::move(Direction direction) {
     sista::Coordinates nextCoordinates = coordinates + directionMap[direction];
     if (field->isOutOfBounds(nextCoordinates)) {
         return;
-    } else if (field->isOccupied(nextCoordinates)) {
-        Entity* entity = (Entity*)field->getPawn(nextCoordinates);
-        if (entity->type == Type::WALL) {
-            return;
-        } else if (entity->type == Type::CHEST) {
-            inventory += ((Chest*)entity)->inventory;
-            Chest::removeChest((Chest*)entity);
-        } else if (entity->type == Type::MINE) {
-            Mine* mine = (Mine*)entity;
-            mine->triggered = true;
+    }
+    switch (field->typeAt(nextCoordinates)) {
+        case Type::EMPTY:
+            break;
+        case Type::CHEST: {
+            Chest* chest = (Chest*)field->getPawn(nextCoordinates);
+            inventory += chest->inventory;
+            Chest::removeChest(chest);
+            break;
+        }
+        case Type::MINE:
+            ((Mine*)field->getPawn(nextCoordinates))->triggered = true;
             return;
-        } else if (entity->type == Type::EGG) {
-            Egg::removeEgg((Egg*)entity);
-        } else if (entity->type == Type::CHICKEN) {
+        case Type::EGG:
+            Egg::removeEgg((Egg*)field->getPawn(nextCoordinates));
+            break;
+        case Type::CHICKEN:
             inventory.meat += 2;
-            Chicken::removeChicken((Chicken*)entity);
-        } else if (entity->type == Type::WEASEL) {
+            Chicken::removeChicken((Chicken*)field->getPawn(nextCoordinates));
+            break;
+        case Type::WEASEL:
             inventory.meat += 2;
-            Weasel::removeWeasel((Weasel*)entity);
-        } else if (entity->type == Type::SNAKE) {
+            Weasel::removeWeasel((Weasel*)field->getPawn(nextCoordinates));
+            break;
+        case Type::SNAKE:
             inventory.meat++;
-            Snake::removeSnake((Snake*)entity);
-        } else if (entity->type == Type::GATE) {
+            Snake::removeSnake((Snake*)field->getPawn(nextCoordinates));
+            break;
+        case Type::GATE:
             if (day) {
                 // Pass through the gate
                 nextCoordinates = coordinates + directionMap[direction]*2;
@@ -1180,19 +2230,13 @@ void Player::move(Direction direction) {
                 }
             } // else, the gate is closed
             return;
-        } else if (entity->type == Type::TRAP || entity->type == Type::WALL || entity->type == Type::BULLET) {
+        case Type::TRAP: case Type::WALL: case Type::BULLET:
             return;
-        } else if (entity->type == Type::ENEMYBULLET || entity->type == Type::WALKER || entity->type == Type::ARCHER) {
-            end = true;
-            sista::resetAnsi();
-            cursor.goTo(HEIGHT, 80);
-            sista::setAttribute(sista::Attribute::BLINK);
-            sista::setBackgroundColor(sista::BackgroundColor::RED);
-            sista::setForegroundColor(sista::ForegroundColor::BLACK);
-            std::cout << "You ran into an enemy entity!";
-            sista::resetAnsi();
+        case Type::ENEMYBULLET: case Type::WALKER: case Type::ARCHER:
+            lose("You ran into an enemy entity!");
             return;
-        }
+        case Type::PLAYER:
+            break;
     }
     field->movePawn(this, nextCoordinates);
     coordinates = nextCoordinates;
@@ -1202,44 +2246,89 @@ void Player::shoot(Direction direction) {
     sista::Coordinates targetCoordinates = coordinates + directionMap[direction];
     if (field->isOutOfBounds(targetCoordinates)) {
         return;
-    } else if (field->isOccupied(targetCoordinates)) {
-        Entity* entity = (Entity*)field->getPawn(targetCoordinates);
-        if (entity->type == Type::WALL) {
+    }
+    Type target = field->typeAt(targetCoordinates);
+    if (target == Type::EMPTY) {
+        if (mode == Mode::BULLET) {
+            if (inventory.eggs <= 0) {
+                return;
+            }
+            inventory.eggs--;
+            spawn(Bullet::bullets, makePooled<Bullet>(targetCoordinates, direction));
+        } else if (mode == Mode::DUMPCHEST) {
+            if (inventory.walls > 0 || inventory.eggs > 0 || inventory.meat > 0) {
+                spawn(Chest::chests, makePooled<Chest>(targetCoordinates, inventory));
+                inventory = {0, 0, 0};
+            }
+        } else if (mode == Mode::WALL) {
+            if (inventory.walls > 0) {
+                spawn(Wall::walls, makePooled<Wall>(targetCoordinates, 3));
+                inventory.walls--;
+            }
+        } else if (mode == Mode::GATE) {
+            if (inventory.walls >= 2 && inventory.eggs > 0) {
+                inventory.walls -= 2;
+                inventory.eggs--;
+                spawn(Gate::gates, makePooled<Gate>(targetCoordinates));
+            }
+        } else if (mode == Mode::TRAP) {
+            if (inventory.walls > 0 && inventory.meat > 0) {
+                inventory.walls--;
+                inventory.meat--;
+                spawn(Trap::traps, makePooled<Trap>(targetCoordinates));
+            }
+        } else if (mode == Mode::MINE) {
+            if (inventory.walls > 0 && inventory.eggs >= 3) {
+                inventory.walls--;
+                inventory.eggs -= 3;
+                spawn(Mine::mines, makePooled<Mine>(targetCoordinates));
+            }
+        } else if (mode == Mode::HATCH) {
+            if (inventory.eggs > 0) {
+                if (Egg::hatchingDistribution(rng.player)) {
+                    spawn(Chicken::chickens, makePooled<Chicken>(targetCoordinates));
+                }
+                inventory.eggs--;
+            }
+        }
+        return;
+    }
+    Entity* entity = (Entity*)field->getPawn(targetCoordinates);
+    switch (target) {
+        case Type::WALL: {
             Wall* wall = (Wall*)entity;
             if (mode == Mode::BULLET) {
                 if (inventory.eggs <= 0) {
                     return;
                 }
-                wall->strength--;
-                if (wall->strength == 0) {
-                    wall->setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
-                    field->rePrintPawn(wall); // It will be reprinted in the next frame and then removed because of (strength == 0)
-                }
+                wall->damage(1);
             } else if (mode == Mode::GATE) {
                 // Replace the wall with a gate
-                Wall::removeWall((Wall*)entity);
-                Gate::gates.push_back(std::make_shared<Gate>(targetCoordinates));
-                field->addPrintPawn(Gate::gates.back());
+                Wall::removeWall(wall);
+                spawn(Gate::gates, makePooled<Gate>(targetCoordinates));
             } else if (mode == Mode::COLLECT) {
                 // Collect the wall
                 inventory.walls += wall->strength;
-                Wall::removeWall((Wall*)entity);
+                Wall::removeWall(wall);
             }
             return;
-        } else if (entity->type == Type::CHEST) {
+        }
+        case Type::CHEST:
             inventory += ((Chest*)entity)->inventory;
             Chest::removeChest((Chest*)entity);
-        } else if (entity->type == Type::MINE) {
-            Mine* mine = (Mine*)entity;
-            mine->triggered = true;
-        } else if (entity->type == Type::TRAP) {
+            break;
+        case Type::MINE:
+            ((Mine*)entity)->triggered = true;
+            break;
+        case Type::TRAP:
             if (mode == Mode::BULLET) {
                 if (inventory.eggs > 0) {
                     inventory.eggs--;
                     Trap::removeTrap((Trap*)entity);
                 }
             }
-        } else if (entity->type == Type::WEASEL) {
+            break;
+        case Type::WEASEL:
             if (mode == Mode::BULLET) {
                 if (inventory.eggs > 0) {
                     inventory.eggs--;
@@ -1250,7 +2339,8 @@ void Player::shoot(Direction direction) {
                 inventory.meat++;
                 Weasel::removeWeasel((Weasel*)entity);
             }
-        } else if (entity->type == Type::SNAKE) {
+            break;
+        case Type::SNAKE:
             if (mode == Mode::BULLET) {
                 if (inventory.eggs > 0) {
                     inventory.eggs--;
@@ -1261,14 +2351,16 @@ void Player::shoot(Direction direction) {
                 inventory.meat++;
                 Snake::removeSnake((Snake*)entity);
             }
-        } else if (entity->type == Type::GATE) {
+            break;
+        case Type::GATE:
             if (mode == Mode::BULLET) {
                 if (inventory.eggs > 0) {
                     inventory.eggs--;
                     Gate::removeGate((Gate*)entity);
                 }
             }
-        } else if (entity->type == Type::CHICKEN) {
+            break;
+        case Type::CHICKEN:
             if (mode == Mode::BULLET) {
                 if (inventory.eggs > 0) {
                     inventory.eggs--;
@@ -1279,7 +2371,8 @@ void Player::shoot(Direction direction) {
                 inventory.meat++;
                 Chicken::removeChicken((Chicken*)entity);
             }
-        } else if (entity->type == Type::EGG) {
+            break;
+        case Type::EGG:
             if (mode == Mode::BULLET) {
                 if (inventory.eggs > 0) {
                     inventory.eggs--;
@@ -1289,57 +2382,9 @@ void Player::shoot(Direction direction) {
                 inventory.eggs++;
                 Egg::removeEgg((Egg*)entity);
             }
-        }
-    } else if (field->isFree(targetCoordinates)) {
-        if (mode == Mode::BULLET) {
-            if (inventory.eggs <= 0) {
-                return;
-            }
-            inventory.eggs--;
-            Bullet::bullets.push_back(std::make_shared<Bullet>(targetCoordinates, direction));
-            field->addPrintPawn(Bullet::bullets.back());
-        } else if (mode == Mode::DUMPCHEST) {
-            if (inventory.walls > 0 || inventory.eggs > 0 || inventory.meat > 0) {
-                Chest::chests.push_back(std::make_shared<Chest>(targetCoordinates, inventory));
-                field->addPrintPawn(Chest::chests.back());
-                inventory = {0, 0, 0};
-            }
-        } else if (mode == Mode::WALL) {
-            if (inventory.walls > 0) {
-                Wall::walls.push_back(std::make_shared<Wall>(targetCoordinates, 3));
-                field->addPrintPawn(Wall::walls.back());
-                inventory.walls--;
-            }
-        } else if (mode == Mode::GATE) {
-            if (inventory.walls >= 2 && inventory.eggs > 0) {
-                inventory.walls -= 2;
-                inventory.eggs--;
-                Gate::gates.push_back(std::make_shared<Gate>(targetCoordinates));
-                field->addPrintPawn(Gate::gates.back());
-            }
-        } else if (mode == Mode::TRAP) {
-            if (inventory.walls > 0 && inventory.meat > 0) {
-                inventory.walls--;
-                inventory.meat--;
-                Trap::traps.push_back(std::make_shared<Trap>(targetCoordinates));
-                field->addPrintPawn(Trap::traps.back());
-            }
-        } else if (mode == Mode::MINE) {
-            if (inventory.walls > 0 && inventory.eggs >= 3) {
-                inventory.walls--;
-                inventory.eggs -= 3;
-                Mine::mines.push_back(std::make_shared<Mine>(targetCoordinates));
-                field->addPrintPawn(Mine::mines.back());
-            }
-        } else if (mode == Mode::HATCH) {
-            if (inventory.eggs > 0) {
-                if (Egg::hatchingDistribution(rng)) {
-                    Chicken::chickens.push_back(std::make_shared<Chicken>(targetCoordinates));
-                    field->addPrintPawn(Chicken::chickens.back());
-                }
-                inventory.eggs--;
-            }
-        }
+            break;
+        default:
+            break;
     }
 }
 
@@ -1350,93 +2395,53 @@ sista::ANSISettings Bullet::bulletStyle = {
     sista::Attribute::BRIGHT
 };
 void Bullet::removeBullet(Bullet* bullet) {
-    auto it = std::find_if(Bullet::bullets.begin(), Bullet::bullets.end(),
-        [bullet](const std::shared_ptr<Bullet>& b) { return b.get() == bullet; });
-    if (it != Bullet::bullets.end()) {
-        field->erasePawn(bullet);
-        Bullet::bullets.erase(it);
-    }
+    despawn(Bullet::bullets, bullet);
 }
 Bullet::Bullet() : Entity(' ', {0, 0}, bulletStyle, Type::BULLET), direction(Direction::RIGHT), speed(1) {}
 Bullet::Bullet(sista::Coordinates coordinates, Direction direction) : Entity(directionSymbol[direction], coordinates, bulletStyle, Type::BULLET), direction(direction), speed(1) {}
 Bullet::Bullet(sista::Coordinates coordinates, Direction direction, unsigned short speed) : Entity(directionSymbol[direction], coordinates, bulletStyle, Type::BULLET), direction(direction), speed(speed) {}
-void Bullet::move() {
-    sista::Coordinates nextCoordinates = coordinates + directionMap[direction]*speed;
-    if (field->isOutOfBounds(nextCoordinates)) {
-        Bullet::removeBullet(this);
-        return;
-    } else if (field->isFree(nextCoordinates)) {
-        field->movePawn(this, nextCoordinates);
-        coordinates = nextCoordinates;
-        return;
-    } else { // Something was hitten
-        Entity* hitten = (Entity*)field->getPawn(nextCoordinates);
-        if (hitten->type == Type::WALL) {
-            Wall* wall = (Wall*)hitten;
-            wall->strength--;
-            if (wall->strength == 0) {
-                wall->setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
-                field->rePrintPawn(wall); // It will be reprinted in the next frame and then removed because of (strength == 0)
-            }
-        } else if (hitten->type == Type::ARCHER) {
-            // debug << "\tZombie" << std::endl;
-            Archer::removeArcher((Archer*)hitten);
-            // debug << "\tZombie removed" << std::endl;
-        } else if (hitten->type == Type::WALKER) {
-            // debug << "\tWalker" << std::endl;
-            Walker::removeWalker((Walker*)hitten);
-            // debug << "\tWalker removed" << std::endl;
-        } else if (hitten->type == Type::BULLET) {
-            // debug << "\tBullet" << std::endl;
-            ((Bullet*)hitten)->collided = true;
-            // debug << "\tBullet collided" << std::endl;
-            // Bullet::removeBullet((Bullet*)hitten);
-            return;
-        } else if (hitten->type == Type::ENEMYBULLET) {
-            // When two bullets collide, their "collided" attribute is set to true
-            // debug << "\tEnemy bullet" << std::endl;
-            ((EnemyBullet*)hitten)->collided = true;
-            // debug << "\tEnemy bullet collided" << std::endl;
-            collided = true;
-            // debug << "\tBullet collided" << std::endl;
-            return;
-        } else if (hitten->type == Type::MINE) {
-            // debug << "\tMine" << std::endl;
-            Mine* mine = (Mine*)hitten;
-            mine->triggered = true;
-            // debug << "\tMine triggered" << std::endl;
-        } else if (hitten->type == Type::CHEST) {
-            // debug << "\tChest" << std::endl;
-            Chest::removeChest((Chest*)hitten);
-            // debug << "\tChest removed" << std::endl;
-        } else if (hitten->type == Type::TRAP) {
-            // debug << "\tTrap" << std::endl;
-            Trap::removeTrap((Trap*)hitten);
-            // debug << "\tTrap removed" << std::endl;
-        } else if (hitten->type == Type::WEASEL) {
-            // debug << "\tWeasel" << std::endl;
-            Weasel::removeWeasel((Weasel*)hitten);
-            // debug << "\tWeasel removed" << std::endl;
-        } else if (hitten->type == Type::SNAKE) {
-            // debug << "\tSnake" << std::endl;
-            Snake::removeSnake((Snake*)hitten);
-            // debug << "\tSnake removed" << std::endl;
-        } else if (hitten->type == Type::GATE) {
-            // debug << "\tGate" << std::endl;
-            Gate::removeGate((Gate*)hitten);
-            // debug << "\tGate removed" << std::endl;
-        } else if (hitten->type == Type::CHICKEN) {
-            // debug << "\tChicken" << std::endl;
-            Chicken::removeChicken((Chicken*)hitten);
-            // debug << "\tChicken removed" << std::endl;
-        } else if (hitten->type == Type::EGG) {
-            // debug << "\tEgg" << std::endl;
-            Egg::removeEgg((Egg*)hitten);
-            // debug << "\tEgg removed" << std::endl;
-        }
-        // debug << "\tAfter collision" << std::endl;
-        Bullet::removeBullet(this);
-        // debug << "\tAfter remove" << std::endl;
+sista::Coordinates Bullet::target() {
+    return coordinates + directionMap[direction]*speed;
+}
+void Bullet::hit(Entity* entity) {
+    switch (entity->type) {
+        case Type::WALL: {
+            Wall* wall = (Wall*)entity;
+            wall->damage(1);
+            break;
+        }
+        case Type::ARCHER:
+            Archer::removeArcher((Archer*)entity);
+            break;
+        case Type::WALKER:
+            Walker::removeWalker((Walker*)entity);
+            break;
+        case Type::MINE:
+            ((Mine*)entity)->triggered = true;
+            break;
+        case Type::CHEST:
+            Chest::removeChest((Chest*)entity);
+            break;
+        case Type::TRAP:
+            Trap::removeTrap((Trap*)entity);
+            break;
+        case Type::WEASEL:
+            Weasel::removeWeasel((Weasel*)entity);
+            break;
+        case Type::SNAKE:
+            Snake::removeSnake((Snake*)entity);
+            break;
+        case Type::GATE:
+            Gate::removeGate((Gate*)entity);
+            break;
+        case Type::CHICKEN:
+            Chicken::removeChicken((Chicken*)entity);
+            break;
+        case Type::EGG:
+            Egg::removeEgg((Egg*)entity);
+            break;
+        default:
+            break;
     }
 }
 
@@ -1446,73 +2451,176 @@ sista::ANSISettings EnemyBullet::enemyBulletStyle = {
     sista::BackgroundColor::BLACK,
     sista::Attribute::BRIGHT
 };
-EnemyBullet::EnemyBullet(sista::Coordinates coordinates, Direction direction, unsigned short speed) : Entity(directionSymbol[direction], coordinates, enemyBulletStyle, Type::BULLET), direction(direction), speed(speed) {}
-EnemyBullet::EnemyBullet(sista::Coordinates coordinates, Direction direction) : Entity(directionSymbol[direction], coordinates, enemyBulletStyle, Type::BULLET), direction(direction), speed(1) {}
+EnemyBullet::EnemyBullet(sista::Coordinates coordinates, Direction direction, unsigned short speed) : Entity(directionSymbol[direction], coordinates, enemyBulletStyle, Type::ENEMYBULLET), direction(direction), speed(speed) {}
+EnemyBullet::EnemyBullet(sista::Coordinates coordinates, Direction direction) : Entity(directionSymbol[direction], coordinates, enemyBulletStyle, Type::ENEMYBULLET), direction(direction), speed(1) {}
 EnemyBullet::EnemyBullet() : Entity(' ', {0, 0}, enemyBulletStyle, Type::ENEMYBULLET), direction(Direction::UP), speed(1) {}
 void EnemyBullet::removeEnemyBullet(EnemyBullet* enemyBullet) {
-    auto it = std::find_if(EnemyBullet::enemyBullets.begin(), EnemyBullet::enemyBullets.end(),
-        [enemyBullet](const std::shared_ptr<EnemyBullet>& b) { return b.get() == enemyBullet; });
-    if (it != EnemyBullet::enemyBullets.end()) {
-        field->erasePawn(enemyBullet);
-        EnemyBullet::enemyBullets.erase(it);
-    }
+    despawn(EnemyBullet::enemyBullets, enemyBullet);
 }
-void EnemyBullet::move() { // Pretty sure there's a segfault here
-    sista::Coordinates nextCoordinates = coordinates + directionMap[direction]*speed;
-    if (field->isOutOfBounds(nextCoordinates)) {
-        EnemyBullet::removeEnemyBullet(this);
-        return;
-    } else if (field->isFree(nextCoordinates)) {
-        field->movePawn(this, nextCoordinates);
-        coordinates = nextCoordinates;
-        return;
-    } else { // Something was hitten
-        Entity* hitten = (Entity*)field->getPawn(nextCoordinates);
-        if (hitten->type == Type::PLAYER) {
-            // lose();
-            end = true;
-            sista::resetAnsi();
-            cursor.goTo(HEIGHT, 80);
-            sista::setAttribute(sista::Attribute::BLINK);
-            sista::setBackgroundColor(sista::BackgroundColor::RED);
-            sista::setForegroundColor(sista::ForegroundColor::BLACK);
-            std::cout << "You were hit by an enemy bullet!";
-            sista::resetAnsi();
-        } else if (hitten->type == Type::WALL) {
-            Wall* wall = (Wall*)hitten;
-            wall->strength--;
-            if (wall->strength == 0) {
-                wall->setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
-                field->rePrintPawn(wall); // It will be reprinted in the next frame and then removed because of (strength == 0)
-            }
-        } else if (hitten->type == Type::BULLET) {
-            ((Bullet*)hitten)->collided = true;
-            collided = true;
-            return;
-        } else if (hitten->type == Type::ARCHER || hitten->type == Type::WALKER) {
+sista::Coordinates EnemyBullet::target() {
+    return coordinates + directionMap[direction]*speed;
+}
+void EnemyBullet::hit(Entity* entity) {
+    switch (entity->type) {
+        case Type::PLAYER:
+            lose("You were hit by an enemy bullet!");
+            break;
+        case Type::WALL: {
+            Wall* wall = (Wall*)entity;
+            wall->damage(1);
+            break;
+        }
+        case Type::ARCHER: case Type::WALKER:
             // No friendly fire
-        } else if (hitten->type == Type::ENEMYBULLET) {
-            collided = true;
-            return;
-        } else if (hitten->type == Type::MINE) {
-            Mine* mine = (Mine*)hitten;
-            mine->triggered = true;
-        } else if (hitten->type == Type::CHEST) {
-            Chest::removeChest((Chest*)hitten);
-        } else if (hitten->type == Type::TRAP) {
-            Trap::removeTrap((Trap*)hitten);
-        } else if (hitten->type == Type::WEASEL) {
-            Weasel::removeWeasel((Weasel*)hitten);
-        } else if (hitten->type == Type::SNAKE) {
-            Snake::removeSnake((Snake*)hitten);
-        } else if (hitten->type == Type::GATE) {
-            Gate::removeGate((Gate*)hitten);
-        } else if (hitten->type == Type::CHICKEN) {
-            Chicken::removeChicken((Chicken*)hitten);
-        } else if (hitten->type == Type::EGG) {
-            Egg::removeEgg((Egg*)hitten);
-        }
-        EnemyBullet::removeEnemyBullet(this);
+            break;
+        case Type::MINE:
+            ((Mine*)entity)->triggered = true;
+            break;
+        case Type::CHEST:
+            Chest::removeChest((Chest*)entity);
+            break;
+        case Type::TRAP:
+            Trap::removeTrap((Trap*)entity);
+            break;
+        case Type::WEASEL:
+            Weasel::removeWeasel((Weasel*)entity);
+            break;
+        case Type::SNAKE:
+            Snake::removeSnake((Snake*)entity);
+            break;
+        case Type::GATE:
+            Gate::removeGate((Gate*)entity);
+            break;
+        case Type::CHICKEN:
+            Chicken::removeChicken((Chicken*)entity);
+            break;
+        case Type::EGG:
+            Egg::removeEgg((Egg*)entity);
+            break;
+        default:
+            break;
+    }
+}
+
+
+void moveProjectiles() {
+    std::pmr::vector<Intent> intents(&tickArena);
+    std::pmr::unordered_map<uint32_t, uint32_t> claims(&tickArena); // Cell -> bullets headed there
+    std::pmr::unordered_map<uint32_t, uint32_t> starts(&tickArena); // Cell -> intent of the bullet leaving it
+    auto key = [](sista::Coordinates coordinates) { return (uint32_t)coordinates.y << 16 | coordinates.x; };
+
+    // Intent: every bullet looks at the field as it is now, nothing is changed yet
+    auto intend = [&](std::shared_ptr<Entity> mover, sista::Coordinates to) {
+        Intent intent{std::move(mover), {0, 0}, to};
+        intent.from = intent.mover->getCoordinates();
+        intent.outOfBounds = field->isOutOfBounds(intent.to);
+        intents.push_back(std::move(intent));
+    };
+    for (const std::shared_ptr<Bullet>& bullet : Bullet::bullets) intend(bullet, bullet->target());
+    for (const std::shared_ptr<EnemyBullet>& enemyBullet : EnemyBullet::enemyBullets) intend(enemyBullet, enemyBullet->target());
+
+    // Resolve: bullets headed to the same cell, or through each other, collide and are both destroyed
+    for (uint32_t k=0; k<intents.size(); k++) {
+        starts[key(intents[k].from)] = k;
+        if (!intents[k].outOfBounds) claims[key(intents[k].to)]++;
+    }
+    for (Intent& intent : intents) {
+        if (intent.outOfBounds) continue;
+        if (claims[key(intent.to)] > 1) {
+            intent.collided = true;
+            continue;
+        }
+        auto other = starts.find(key(intent.to));
+        if (other != starts.end() && !intents[other->second].outOfBounds && intents[other->second].to == intent.from) {
+            intent.collided = true;
+        }
+    }
+
+    // Apply: every cell is hit by one bullet at most, so the hits don't depend on the order either;
+    // the bullets that move are lifted off the field first, as they may be headed where another one is
+    auto remove = [](Entity* mover) {
+        if (mover->type == Type::BULLET) {
+            Bullet::removeBullet((Bullet*)mover);
+        } else {
+            EnemyBullet::removeEnemyBullet((EnemyBullet*)mover);
+        }
+    };
+    size_t moving = 0;
+    for (Intent& intent : intents) {
+        Entity* mover = intent.mover.get();
+        if (intent.outOfBounds || intent.collided) {
+            remove(mover);
+            continue;
+        }
+        Type target = field->typeAt(intent.to);
+        if (target == Type::EMPTY || target == Type::BULLET || target == Type::ENEMYBULLET) {
+            intents[moving++] = intent; // Bullets always leave their cell, by moving or by being removed
+            continue;
+        }
+        Entity* entity = (Entity*)field->getPawn(intent.to);
+        if (mover->type == Type::BULLET) {
+            ((Bullet*)mover)->hit(entity);
+        } else {
+            ((EnemyBullet*)mover)->hit(entity);
+        }
+        remove(mover);
+    }
+    intents.resize(moving);
+    for (Intent& intent : intents) {
+        field->erasePawn(intent.mover.get());
+    }
+    for (Intent& intent : intents) {
+        intent.mover->setCoordinates(intent.to);
+        field->addPrintPawn(intent.mover);
+    }
+}
+
+void moveWalkers() {
+    auto before = [](const Intent& a, const Intent& b) {
+        return a.from.y != b.from.y ? a.from.y < b.from.y : a.from.x < b.from.x;
+    };
+
+    // Intent: every region picks the steps of its walkers from the field as it is now, from the top left one,
+    // so neither the slot map order nor the other regions change what they see or draw
+    std::pmr::vector<std::pmr::vector<Intent>> planned(regions.size(), &tickArena);
+    for (const std::shared_ptr<Walker>& walker : Walker::walkers) {
+        sista::Coordinates from = walker->getCoordinates();
+        planned[from.y / REGION_HEIGHT].push_back(Intent{walker, from, from});
+    }
+    auto planRegion = [&planned, &before](size_t r) {
+        region = &regions[r];
+        std::sort(planned[r].begin(), planned[r].end(), before);
+        for (Intent& intent : planned[r]) {
+            if (!Walker::movingDistribution(mobStream())) continue;
+            intent.to = ((Walker*)intent.mover.get())->target();
+            intent.outOfBounds = field->isOutOfBounds(intent.to);
+        }
+        region = nullptr;
+    };
+    if (Walker::walkers.size() >= PARALLEL_MOBS) {
+        workers.run(regions.size(), planRegion);
+    } else {
+        for (size_t r=0; r<regions.size(); r++) planRegion(r);
+    }
+
+    // Resolve: a cell is taken by one walker at most, the first one from the top left, the others wait;
+    // walkers don't step where another one is, so they can't pass through each other either
+    std::pmr::vector<Intent> intents(&tickArena);
+    std::pmr::unordered_set<uint32_t> claimed(&tickArena);
+    for (std::pmr::vector<Intent>& each : planned) {
+        for (Intent& intent : each) {
+            if (intent.outOfBounds || intent.to == intent.from) continue;
+            if (claimed.insert((uint32_t)intent.to.y << 16 | intent.to.x).second) intents.push_back(std::move(intent));
+        }
+    }
+
+    // Apply: the moves to empty cells first, then what the others run into, in the same order as they were picked
+    for (Intent& intent : intents) {
+        if (field->typeAt(intent.to) == Type::EMPTY) ((Walker*)intent.mover.get())->step(intent.to);
+    }
+    for (Intent& intent : intents) {
+        Walker* walker = (Walker*)intent.mover.get();
+        if (walker->getCoordinates() == intent.from) walker->step(intent.to);
     }
 }
 
@@ -1522,82 +2630,90 @@ sista::ANSISettings Mine::mineStyle = {
     sista::Attribute::BLINK   
 };
 void Mine::removeMine(Mine* mine) {
-    auto it = std::find_if(Mine::mines.begin(), Mine::mines.end(),
-        [mine](const std::shared_ptr<Mine>& z) { return z.get() == mine; });
-    if (it != Mine::mines.end()) {
-        field->erasePawn(mine);
-        Mine::mines.erase(it);
-    }
+    despawn(Mine::mines, mine);
 }
 Mine::Mine(sista::Coordinates coordinates) : Entity('*', coordinates, mineStyle, Type::MINE), triggered(false) {}
 Mine::Mine() : Entity('*', {0, 0}, mineStyle, Type::MINE), triggered(false) {}
-bool Mine::checkTrigger() {
-    for (int j=-1; j<=1; j++) {
-        for (int i=-1; i<=1; i++) {
-            if (i == 0 && j == 0) continue;
-            sista::Coordinates nextCoordinates = coordinates + sista::Coordinates(j, i);
-            if (field->isOutOfBounds(nextCoordinates)) continue;
-            Entity* neighbor = (Entity*)field->getPawn(nextCoordinates);
-            if (neighbor == nullptr) {
-                continue;
-            } else if (neighbor->type == Type::ARCHER || neighbor->type == Type::WALKER) {
-                trigger();
-                return true;
-            }
-        }
-    }
-    return false;
-}
 void Mine::trigger() {
     triggered = true;
     symbol = '%';
     settings.foregroundColor = sista::ForegroundColor::WHITE;
 }
-void Mine::explode() {
-    for (int j=-2; j<=2; j++) {
-        for (int i=-2; i<=2; i++) {
-            if (i == 0 && j == 0) continue;
-            sista::Coordinates nextCoordinates = coordinates + sista::Coordinates(j, i);
-            if (field->isOutOfBounds(nextCoordinates)) continue;
-            Entity* neighbor = (Entity*)field->getPawn(nextCoordinates);
-            if (neighbor == nullptr) {
-                continue;
-            } else if (neighbor->type == Type::ARCHER) {
-                Archer::removeArcher((Archer*)neighbor);
-            } else if (neighbor->type == Type::WALKER) {
-                Walker::removeWalker((Walker*)neighbor);
-            } else if (neighbor->type == Type::ENEMYBULLET) {
-                EnemyBullet::removeEnemyBullet((EnemyBullet*)neighbor);
-            } else if (neighbor->type == Type::MINE) {
-                Mine* mine = (Mine*)neighbor;
-                mine->triggered = true;
-            } else if (neighbor->type == Type::CHEST) {
-                Chest::removeChest((Chest*)neighbor);
-            } else if (neighbor->type == Type::TRAP) {
-                Trap::removeTrap((Trap*)neighbor);
-            } else if (neighbor->type == Type::WEASEL) {
-                Weasel::removeWeasel((Weasel*)neighbor);
-            } else if (neighbor->type == Type::SNAKE) {
-                Snake::removeSnake((Snake*)neighbor);
-            } else if (neighbor->type == Type::GATE) {
-                Gate::removeGate((Gate*)neighbor);
-            } else if (neighbor->type == Type::CHICKEN) {
-                Chicken::removeChicken((Chicken*)neighbor);
-            } else if (neighbor->type == Type::EGG) {
-                Egg::removeEgg((Egg*)neighbor);
-            } else if (neighbor->type == Type::WALL) {
-                Wall* wall = (Wall*)neighbor;
-                int damage = rand() % 3 + 1;
-                if (wall->strength <= damage) {
-                    wall->strength = 0;
-                    wall->setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
-                    field->rePrintPawn(wall); // It will be reprinted in the next frame and then removed because of (strength == 0)
+void Mine::explodeTriggered() {
+    std::pmr::vector<Mine*> exploding(&tickArena); // Breadth first, the triggered mines and then the ones they reach
+    std::pmr::vector<Entity*> victims(&tickArena);
+    std::pmr::unordered_set<uint32_t> blasted(&tickArena); // Cells already reached by a blast, each one is hit once
+    auto key = [](sista::Coordinates coordinates) { return (uint32_t)coordinates.y << 16 | coordinates.x; };
+    for (const std::shared_ptr<Mine>& mine : Mine::mines) {
+        if (!mine->triggered) continue;
+        exploding.push_back(mine.get());
+        blasted.insert(key(mine->coordinates));
+    }
+    for (size_t k=0; k<exploding.size(); k++) {
+        Mine* mine = exploding[k];
+        victims.push_back(mine);
+        for (int j=-2; j<=2; j++) {
+            for (int i=-2; i<=2; i++) {
+                sista::Coordinates nextCoordinates = mine->coordinates + sista::Coordinates(j, i);
+                if (field->isOutOfBounds(nextCoordinates)) continue;
+                if (!blasted.insert(key(nextCoordinates)).second) continue;
+                Type neighbor = field->typeAt(nextCoordinates);
+                if (neighbor == Type::EMPTY || neighbor == Type::PLAYER || neighbor == Type::BULLET) continue;
+                Entity* entity = (Entity*)field->getPawn(nextCoordinates);
+                if (neighbor == Type::MINE) {
+                    // Chain reaction, it explodes in this same batch
+                    ((Mine*)entity)->trigger();
+                    exploding.push_back((Mine*)entity);
+                } else if (neighbor == Type::WALL) {
+                    Wall* wall = (Wall*)entity;
+                    int damage = rng.combat.below(3) + 1;
+                    wall->damage(damage);
                 } else {
-                    wall->strength -= damage;
+                    victims.push_back(entity);
                 }
             }
         }
     }
+    // Nothing was removed while the blasts were spreading, so the victims go in a single pass
+    for (Entity* victim : victims) {
+        switch (victim->type) {
+            case Type::MINE:
+                Mine::removeMine((Mine*)victim);
+                break;
+            case Type::ARCHER:
+                Archer::removeArcher((Archer*)victim);
+                break;
+            case Type::WALKER:
+                Walker::removeWalker((Walker*)victim);
+                break;
+            case Type::ENEMYBULLET:
+                EnemyBullet::removeEnemyBullet((EnemyBullet*)victim);
+                break;
+            case Type::CHEST:
+                Chest::removeChest((Chest*)victim);
+                break;
+            case Type::TRAP:
+                Trap::removeTrap((Trap*)victim);
+                break;
+            case Type::WEASEL:
+                Weasel::removeWeasel((Weasel*)victim);
+                break;
+            case Type::SNAKE:
+                Snake::removeSnake((Snake*)victim);
+                break;
+            case Type::GATE:
+                Gate::removeGate((Gate*)victim);
+                break;
+            case Type::CHICKEN:
+                Chicken::removeChicken((Chicken*)victim);
+                break;
+            case Type::EGG:
+                Egg::removeEgg((Egg*)victim);
+                break;
+            default:
+                break;
+        }
+    }
 }
 
 sista::ANSISettings Chest::chestStyle = {
@@ -1606,12 +2722,7 @@ sista::ANSISettings Chest::chestStyle = {
     sista::Attribute::BRIGHT
 };
 void Chest::removeChest(Chest* chest) {
-    auto it = std::find_if(Chest::chests.begin(), Chest::chests.end(),
-        [chest](const std::shared_ptr<Chest>& z) { return z.get() == chest; });
-    if (it != Chest::chests.end()) {
-        field->erasePawn(chest);
-        Chest::chests.erase(it);
-    }
+    despawn(Chest::chests, chest);
 }
 Chest::Chest(sista::Coordinates coordinates, Inventory inventory, bool _) : Entity('C', coordinates, chestStyle, Type::CHEST), inventory(inventory) {}
 Chest::Chest(sista::Coordinates coordinates, Inventory& inventory) : Entity('C', coordinates, chestStyle, Type::CHEST), inventory(inventory) {}
@@ -1623,12 +2734,7 @@ sista::ANSISettings Trap::trapStyle = {
     sista::Attribute::BRIGHT
 };
 void Trap::removeTrap(Trap* trap) {
-    auto it = std::find_if(Trap::traps.begin(), Trap::traps.end(),
-        [trap](const std::shared_ptr<Trap>& z) { return z.get() == trap; });
-    if (it != Trap::traps.end()) {
-        field->erasePawn(trap);
-        Trap::traps.erase(it);
-    }
+    despawn(Trap::traps, trap);
 }
 Trap::Trap(sista::Coordinates coordinates) : Entity('T', coordinates, trapStyle, Type::TRAP) {}
 Trap::Trap() : Entity('T', {0, 0}, trapStyle, Type::TRAP) {}
@@ -1639,12 +2745,7 @@ sista::ANSISettings Weasel::weaselStyle = {
     sista::Attribute::BRIGHT
 };
 void Weasel::removeWeasel(Weasel* weasel) {
-    auto it = std::find_if(Weasel::weasels.begin(), Weasel::weasels.end(),
-        [weasel](const std::shared_ptr<Weasel>& z) { return z.get() == weasel; });
-    if (it != Weasel::weasels.end()) {
-        field->erasePawn(weasel);
-        Weasel::weasels.erase(it);
-    }
+    despawn(Weasel::weasels, weasel);
 }
 Weasel::Weasel(sista::Coordinates coordinates, Direction direction) : Entity('}', coordinates, weaselStyle, Type::WEASEL), direction(direction) {
     symbol = (direction == Direction::RIGHT) ? '}' : '{';
@@ -1657,26 +2758,34 @@ void Weasel::move() {
     if (field->isOutOfBounds(nextCoordinates)) {
         crossed = true;
         return;
-    } else if (field->isOccupied(nextCoordinates)) {
-        Entity* entity = (Entity*)field->getPawn(nextCoordinates);
-        if (entity->type == Type::WALL) {
+    }
+    Type target = field->typeAt(nextCoordinates);
+    if (target == Type::EMPTY) {
+        field->movePawn(this, nextCoordinates);
+        coordinates = nextCoordinates;
+        return;
+    }
+    switch (target) {
+        case Type::WALL:
             direction = (direction == Direction::RIGHT) ? Direction::LEFT : Direction::RIGHT;
             symbol = (direction == Direction::RIGHT) ? '}' : '{';
             return;
-        } else if (entity->type == Type::CHEST) {
+        case Type::CHEST:
             // Steal some meat from the chest
-        } else if (entity->type == Type::MINE) {
-            Mine* mine = (Mine*)entity;
-            mine->triggered = true;
-        } else if (entity->type == Type::TRAP) {
+            break;
+        case Type::MINE:
+            ((Mine*)field->getPawn(nextCoordinates))->triggered = true;
+            break;
+        case Type::TRAP:
             caught = true; // The weasel will be removed
             return;
-        } else if (entity->type == Type::WEASEL) {
+        case Type::WEASEL:
             // They will both be scared and run away
-        } else if (entity->type == Type::SNAKE) {
+            break;
+        case Type::SNAKE:
             crossed = true; // The snake kills the weasel
             return;
-        } else if (entity->type == Type::GATE) {
+        case Type::GATE:
             if (day) {
                 // passing through the gate
                 nextCoordinates = coordinates + directionMap[direction]*2;
@@ -1687,10 +2796,12 @@ void Weasel::move() {
                     return;
                 }
             } // Otherwise change direction
-        } else if (entity->type == Type::CHICKEN) {
+            break;
+        case Type::CHICKEN:
             // Eat the chicken
-            Chicken::removeChicken((Chicken*)entity);
-        } else if (entity->type == Type::EGG) {
+            Chicken::removeChicken((Chicken*)field->getPawn(nextCoordinates));
+            break;
+        case Type::EGG:
             // Jump over the egg
             if (direction == Direction::RIGHT) {
                 nextCoordinates = coordinates + directionMap[Direction::UP];
@@ -1702,16 +2813,15 @@ void Weasel::move() {
                 coordinates = nextCoordinates;
                 return;
             } // Otherwise change direction
-        } else if (entity->type == Type::BULLET || entity->type == Type::ENEMYBULLET) {
+            break;
+        case Type::BULLET: case Type::ENEMYBULLET:
             caught = true; // The weasel will be removed
             return;
-        }
-        direction = (direction == Direction::RIGHT) ? Direction::LEFT : Direction::RIGHT;
-        symbol = (direction == Direction::RIGHT) ? '}' : '{';
-        return;
+        default:
+            break;
     }
-    field->movePawn(this, nextCoordinates);
-    coordinates = nextCoordinates;
+    direction = (direction == Direction::RIGHT) ? Direction::LEFT : Direction::RIGHT;
+    symbol = (direction == Direction::RIGHT) ? '}' : '{';
 }
 
 sista::ANSISettings Snake::snakeStyle = {
@@ -1720,12 +2830,7 @@ sista::ANSISettings Snake::snakeStyle = {
     sista::Attribute::BRIGHT
 };
 void Snake::removeSnake(Snake* snake) {
-    auto it = std::find_if(Snake::snakes.begin(), Snake::snakes.end(),
-        [snake](const std::shared_ptr<Snake>& z) { return z.get() == snake; });
-    if (it != Snake::snakes.end()) {
-        field->erasePawn(snake);
-        Snake::snakes.erase(it);
-    }
+    despawn(Snake::snakes, snake);
 }
 Snake::Snake(sista::Coordinates coordinates, Direction direction) : Entity('~', coordinates, snakeStyle, Type::SNAKE), direction(direction) {}
 Snake::Snake() : Entity('~', {0, 0}, snakeStyle, Type::SNAKE), direction(Direction::RIGHT) {}
@@ -1734,24 +2839,33 @@ void Snake::move() {
     if (field->isOutOfBounds(nextCoordinates)) {
         crossed = true;
         return;
-    } else if (field->isOccupied(nextCoordinates)) {
-        Entity* entity = (Entity*)field->getPawn(nextCoordinates);
-        if (entity->type == Type::WALL) {
+    }
+    Type target = field->typeAt(nextCoordinates);
+    if (target == Type::EMPTY) {
+        field->movePawn(this, nextCoordinates);
+        coordinates = nextCoordinates;
+        return;
+    }
+    switch (target) {
+        case Type::WALL:
             direction = (direction == Direction::RIGHT) ? Direction::LEFT : Direction::RIGHT;
             return;
-        } else if (entity->type == Type::CHEST) {
-            Chest::removeChest((Chest*)entity);
-        } else if (entity->type == Type::MINE) {
-            Mine* mine = (Mine*)entity;
-            mine->triggered = true;
-        } else if (entity->type == Type::TRAP) {
+        case Type::CHEST:
+            Chest::removeChest((Chest*)field->getPawn(nextCoordinates));
+            break;
+        case Type::MINE:
+            ((Mine*)field->getPawn(nextCoordinates))->triggered = true;
+            break;
+        case Type::TRAP:
             // Will just change direction, because traps are only meant for Weasels so far
-        } else if (entity->type == Type::WEASEL) {
-            Weasel::removeWeasel((Weasel*)entity);
-        } else if (entity->type == Type::SNAKE) {
-            Snake::removeSnake((Snake*)entity);
+            break;
+        case Type::WEASEL:
+            Weasel::removeWeasel((Weasel*)field->getPawn(nextCoordinates));
+            break;
+        case Type::SNAKE:
+            Snake::removeSnake((Snake*)field->getPawn(nextCoordinates));
             return;
-        } else if (entity->type == Type::GATE) {
+        case Type::GATE:
             if (day) { // Or maybe the snake should be able to sneak through the closed gate
                 // passing through the gate
                 nextCoordinates = coordinates + directionMap[direction]*2;
@@ -1762,16 +2876,17 @@ void Snake::move() {
                     return;
                 }
             }
-        } else if (entity->type == Type::CHICKEN) {
-            Chicken::removeChicken((Chicken*)entity);
-        } else if (entity->type == Type::EGG) {
-            Egg::removeEgg((Egg*)entity);
-        }
-        direction = (direction == Direction::RIGHT) ? Direction::LEFT : Direction::RIGHT;
-        return;
+            break;
+        case Type::CHICKEN:
+            Chicken::removeChicken((Chicken*)field->getPawn(nextCoordinates));
+            break;
+        case Type::EGG:
+            Egg::removeEgg((Egg*)field->getPawn(nextCoordinates));
+            break;
+        default:
+            break;
     }
-    field->movePawn(this, nextCoordinates);
-    coordinates = nextCoordinates;
+    direction = (direction == Direction::RIGHT) ? Direction::LEFT : Direction::RIGHT;
 }
 
 sista::ANSISettings Chicken::chickenStyle = {
@@ -1780,24 +2895,23 @@ sista::ANSISettings Chicken::chickenStyle = {
     sista::Attribute::ITALIC
 };
 void Chicken::removeChicken(Chicken* chicken) {
-    auto it = std::find_if(Chicken::chickens.begin(), Chicken::chickens.end(),
-        [chicken](const std::shared_ptr<Chicken>& z) { return z.get() == chicken; });
-    if (it != Chicken::chickens.end()) {
-        field->erasePawn(chicken);
-        Chicken::chickens.erase(it);
-    }
+    despawn(Chicken::chickens, chicken);
 }
 Chicken::Chicken(sista::Coordinates coordinates) : Entity('%', coordinates, chickenStyle, Type::CHICKEN) {}
 Chicken::Chicken() : Entity('%', {0, 0}, chickenStyle, Type::CHICKEN) {}
 void Chicken::move() {
-    sista::Coordinates nextCoordinates = coordinates + directionMap[(Direction)(rand() % 4)];
+    sista::Coordinates nextCoordinates = coordinates + directionMap[(Direction)mobStream().below(4)];
     sista::Coordinates oldCoordinates = coordinates;
     if (field->isFree(nextCoordinates)) {
         field->movePawn(this, nextCoordinates);
         coordinates = nextCoordinates;
-        if (field->isFree(oldCoordinates) && eggDistribution(rng)) {
-            Egg::eggs.push_back(std::make_shared<Egg>(oldCoordinates));
-            field->addPrintPawn(Egg::eggs.back());
+        if (movesToEgg > 1) {
+            movesToEgg--;
+        } else {
+            movesToEgg = mobStream().geometric(eggDistribution.p());
+            if (field->isFree(oldCoordinates)) {
+                spawn(Egg::eggs, makePooled<Egg>(oldCoordinates));
+            }
         }
     }
 }
@@ -1808,12 +2922,7 @@ sista::ANSISettings Egg::eggStyle = {
     sista::Attribute::BRIGHT
 };
 void Egg::removeEgg(Egg* egg) {
-    auto it = std::find_if(Egg::eggs.begin(), Egg::eggs.end(),
-        [egg](const std::shared_ptr<Egg>& z) { return z.get() == egg; });
-    if (it != Egg::eggs.end()) {
-        field->erasePawn(egg);
-        Egg::eggs.erase(it);
-    }
+    despawn(Egg::eggs, egg);
 }
 Egg::Egg(sista::Coordinates coordinates) : Entity('0', coordinates, eggStyle, Type::EGG) {}
 Egg::Egg() : Entity('0', {0, 0}, eggStyle, Type::EGG) {}
@@ -1824,12 +2933,7 @@ sista::ANSISettings Gate::gateStyle = {
     sista::Attribute::BRIGHT
 };
 void Gate::removeGate(Gate* gate) {
-    auto it = std::find_if(Gate::gates.begin(), Gate::gates.end(),
-        [gate](const std::shared_ptr<Gate>& z) { return z.get() == gate; });
-    if (it != Gate::gates.end()) {
-        field->erasePawn(gate);
-        Gate::gates.erase(it);
-    }
+    despawn(Gate::gates, gate);
 }
 Gate::Gate(sista::Coordinates coordinates) : Entity('=', coordinates, gateStyle, Type::GATE) {}
 Gate::Gate() : Entity('=', {0, 0}, gateStyle, Type::GATE) {}
@@ -1840,15 +2944,19 @@ sista::ANSISettings Wall::wallStyle = {
     sista::Attribute::BRIGHT
 };
 void Wall::removeWall(Wall* wall) {
-    auto it = std::find_if(Wall::walls.begin(), Wall::walls.end(),
-        [wall](const std::shared_ptr<Wall>& z) { return z.get() == wall; });
-    if (it != Wall::walls.end()) {
-        field->erasePawn(wall);
-        Wall::walls.erase(it);
-    }
+    despawn(Wall::walls, wall);
 }
 Wall::Wall(sista::Coordinates coordinates, short int strength) : Entity('#', coordinates, wallStyle, Type::WALL), strength(strength) {}
 Wall::Wall() : Entity('#', {0, 0}, wallStyle, Type::WALL), strength(1) {}
+void Wall::damage(short int amount) {
+    if (strength <= 0) return; // Already crumbling, its removal is scheduled
+    strength = std::max(strength - amount, 0);
+    if (strength == 0) {
+        setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
+        field->rePrintPawn(this); // It will be reprinted in the next frame and then removed
+        schedule(this);
+    }
+}
 
 sista::ANSISettings Walker::walkerStyle = {
     sista::ForegroundColor::GREEN,
@@ -1856,95 +2964,106 @@ sista::ANSISettings Walker::walkerStyle = {
     sista::Attribute::FAINT
 };
 void Walker::removeWalker(Walker* walker) {
-    auto it = std::find_if(Walker::walkers.begin(), Walker::walkers.end(),
-        [walker](const std::shared_ptr<Walker>& z) { return z.get() == walker; });
-    if (it != Walker::walkers.end()) {
-        field->erasePawn(walker);
-        Walker::walkers.erase(it);
-    }
+    despawn(Walker::walkers, walker);
 }
 Walker::Walker(sista::Coordinates coordinates) : Entity('Z', coordinates, walkerStyle, Type::WALKER) {}
 Walker::Walker() : Entity('Z', {0, 0}, walkerStyle, Type::WALKER) {}
-void Walker::move() {
+sista::Coordinates Walker::target() {
     sista::Coordinates nextCoordinates = coordinates;
-    sista::Coordinates playerCoordinates = Player::player->getCoordinates();
-    if (playerCoordinates.x == coordinates.x) {
-        if (playerCoordinates.y < coordinates.y) {
-            nextCoordinates.y--;
-        } else {
-            nextCoordinates.y++;
+    uint16_t here = flowField.at(coordinates);
+    if (here != FlowField::UNREACHABLE && here > 0) {
+        // Downhill on the flow field, around walls and houses; ties are broken at random
+        Direction steps[4];
+        int candidates = 0;
+        for (Direction direction : {Direction::UP, Direction::RIGHT, Direction::DOWN, Direction::LEFT}) {
+            if (flowField.at(coordinates + directionMap[direction]) < here) steps[candidates++] = direction;
         }
-    } else if (playerCoordinates.y == coordinates.y) {
-        if (playerCoordinates.x < coordinates.x) {
-            nextCoordinates.x--;
-        } else {
-            nextCoordinates.x++;
+        if (candidates > 0) {
+            nextCoordinates = coordinates + directionMap[steps[candidates > 1 ? mobStream().below(candidates) : 0]];
         }
     } else {
-        // The same applies for x = p.x +- 2 and y = p.y +- 2, the walker will move towards the player
-        if (playerCoordinates.x < coordinates.x) {
-            if (coordinates.x - playerCoordinates.x <= 2) {
-                if (playerCoordinates.y < coordinates.y) {
-                    nextCoordinates.y--;
-                } else {
-                    nextCoordinates.y++;
-                }
+        // Too far from the player, or shut out by walls: the old greedy rule, which breaks through them
+        sista::Coordinates playerCoordinates = Player::player->getCoordinates();
+        if (playerCoordinates.x == coordinates.x) {
+            if (playerCoordinates.y < coordinates.y) {
+                nextCoordinates.y--;
             } else {
-                // Randomly choose the direction
-                nextCoordinates = coordinates + directionMap[(Direction)(rand() % 4)];
+                nextCoordinates.y++;
+            }
+        } else if (playerCoordinates.y == coordinates.y) {
+            if (playerCoordinates.x < coordinates.x) {
+                nextCoordinates.x--;
+            } else {
+                nextCoordinates.x++;
             }
         } else {
-            if (playerCoordinates.x - coordinates.x <= 2) {
-                if (playerCoordinates.y < coordinates.y) {
-                    nextCoordinates.y--;
+            // The same applies for x = p.x +- 2 and y = p.y +- 2, the walker will move towards the player
+            if (playerCoordinates.x < coordinates.x) {
+                if (coordinates.x - playerCoordinates.x <= 2) {
+                    if (playerCoordinates.y < coordinates.y) {
+                        nextCoordinates.y--;
+                    } else {
+                        nextCoordinates.y++;
+                    }
                 } else {
-                    nextCoordinates.y++;
+                    // Randomly choose the direction
+                    nextCoordinates = coordinates + directionMap[(Direction)mobStream().below(4)];
                 }
             } else {
-                // Randomly choose the direction
-                nextCoordinates = coordinates + directionMap[(Direction)(rand() % 4)];
-            }
-        }
-        if (playerCoordinates.y < coordinates.y) {
-            if (coordinates.y - playerCoordinates.y <= 2) {
-                if (playerCoordinates.x < coordinates.x) {
-                    nextCoordinates.x--;
+                if (playerCoordinates.x - coordinates.x <= 2) {
+                    if (playerCoordinates.y < coordinates.y) {
+                        nextCoordinates.y--;
+                    } else {
+                        nextCoordinates.y++;
+                    }
                 } else {
-                    nextCoordinates.x++;
+                    // Randomly choose the direction
+                    nextCoordinates = coordinates + directionMap[(Direction)mobStream().below(4)];
                 }
-            } else {
-                // Randomly choose the direction
-                nextCoordinates = coordinates + directionMap[(Direction)(rand() % 4)];
             }
-        } else {
-            if (playerCoordinates.y - coordinates.y <= 2) {
-                if (playerCoordinates.x < coordinates.x) {
-                    nextCoordinates.x--;
+            if (playerCoordinates.y < coordinates.y) {
+                if (coordinates.y - playerCoordinates.y <= 2) {
+                    if (playerCoordinates.x < coordinates.x) {
+                        nextCoordinates.x--;
+                    } else {
+                        nextCoordinates.x++;
+                    }
                 } else {
-                    nextCoordinates.x++;
+                    // Randomly choose the direction
+                    nextCoordinates = coordinates + directionMap[(Direction)mobStream().below(4)];
                 }
             } else {
-                // Randomly choose the direction
-                nextCoordinates = coordinates + directionMap[(Direction)(rand() % 4)];
+                if (playerCoordinates.y - coordinates.y <= 2) {
+                    if (playerCoordinates.x < coordinates.x) {
+                        nextCoordinates.x--;
+                    } else {
+                        nextCoordinates.x++;
+                    }
+                } else {
+                    // Randomly choose the direction
+                    nextCoordinates = coordinates + directionMap[(Direction)mobStream().below(4)];
+                }
             }
         }
     }
-    if (field->isOutOfBounds(nextCoordinates)) {
-        return;
-    } else if (field->isFree(nextCoordinates)) {
+    return nextCoordinates;
+}
+void Walker::step(sista::Coordinates nextCoordinates) {
+    Type target = field->typeAt(nextCoordinates);
+    if (target == Type::EMPTY) {
         field->movePawn(this, nextCoordinates);
         coordinates = nextCoordinates;
-    } else if (field->isOccupied(nextCoordinates)) {
-        Entity* entity = (Entity*)field->getPawn(nextCoordinates);
-        if (entity->type == Type::WALL) {
+        return;
+    }
+    Entity* entity = (Entity*)field->getPawn(nextCoordinates);
+    switch (target) {
+        case Type::WALL: {
             // Walkers break walls
             Wall* wall = (Wall*)entity;
-            wall->strength--;
-            if (wall->strength == 0) {
-                wall->setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
-                field->rePrintPawn(wall); // It will be reprinted in the next frame and then removed because of (strength == 0)
-            }
-        } else if (entity->type == Type::CHEST) {
+            wall->damage(1);
+            break;
+        }
+        case Type::CHEST: {
             Chest *chest = (Chest*)entity;
             if (chest->inventory.meat == 0) {
                 // if there is no meat in the chest, the walker is angry and destroys the chest
@@ -1952,43 +3071,53 @@ void Walker::move() {
             } else {
                 chest->inventory.meat--; // The walker eats the meat
             }
-        } else if (entity->type == Type::MINE) {
-            Mine* mine = (Mine*)entity;
-            mine->triggered = true;
-        } else if (entity->type == Type::WEASEL) {
+            break;
+        }
+        case Type::MINE:
+            ((Mine*)entity)->triggered = true;
+            break;
+        case Type::WEASEL: {
             // The weasel is scared and runs away
             Weasel* weasel = (Weasel*)entity;
             for (int j=0; j<3; j++) {
-                sista::Coordinates nextCoordinates_ = weasel->getCoordinates() + directionMap[(Direction)(rand() % 4)];
+                sista::Coordinates nextCoordinates_ = weasel->getCoordinates() + directionMap[(Direction)mobStream().below(4)];
                 if (field->isFree(nextCoordinates_)) {
                     field->movePawn(weasel, nextCoordinates_);
                     weasel->setCoordinates(nextCoordinates_);
                     return;
                 }
             }
-        } else if (entity->type == Type::SNAKE) {
+            break;
+        }
+        case Type::SNAKE:
             // The two don't care about each other and just swap places
-            field->swapTwoPawns(this, (Walker*)entity); // WARNING: really hope this works
-        } else if (entity->type == Type::GATE || entity->type == Type::TRAP) {
+            field->swapTwoPawns(this, entity); // WARNING: really hope this works
+            break;
+        case Type::GATE: case Type::TRAP:
             // The walker can't pass through the gate and the trap is too small to be triggered
-        } else if (entity->type == Type::CHICKEN) {
+            break;
+        case Type::CHICKEN: {
             // The chicken is scared and moves randomly
             Chicken* chicken = (Chicken*)entity;
             for (int j=0; j<3; j++) {
-                sista::Coordinates nextCoordinates_ = chicken->getCoordinates() + directionMap[(Direction)(rand() % 4)];
+                sista::Coordinates nextCoordinates_ = chicken->getCoordinates() + directionMap[(Direction)mobStream().below(4)];
                 if (field->isFree(nextCoordinates_)) {
                     field->movePawn(chicken, nextCoordinates_);
                     chicken->setCoordinates(nextCoordinates_);
                     break;
                 }
             }
-        } else if (entity->type == Type::EGG) {
+            break;
+        }
+        case Type::EGG:
             // The egg is broken when the walker steps on it
             Egg::removeEgg((Egg*)entity);
             // So the walker can move
             field->movePawn(this, nextCoordinates);
             coordinates = nextCoordinates;
-        }
+            break;
+        default:
+            break;
     }
 }
 
@@ -1998,30 +3127,30 @@ sista::ANSISettings Archer::archerStyle = {
     sista::Attribute::STRIKETHROUGH
 };
 void Archer::removeArcher(Archer* archer) {
-    auto it = std::find_if(Archer::archers.begin(), Archer::archers.end(),
-        [archer](const std::shared_ptr<Archer>& z) { return z.get() == archer; });
-    if (it != Archer::archers.end()) {
-        field->erasePawn(archer);
-        Archer::archers.erase(it);
-    }
+    despawn(Archer::archers, archer);
 }
 Archer::Archer(sista::Coordinates coordinates) : Entity('A', coordinates, archerStyle, Type::ARCHER) {}
 Archer::Archer() : Entity('A', {0, 0}, archerStyle, Type::ARCHER) {}
 void Archer::move() {
-    Direction direction = (Direction)(rand() % 4);
+    Direction direction = (Direction)mobStream().below(4);
     sista::Coordinates nextCoordinates = coordinates + directionMap[direction];
     if (field->isOutOfBounds(nextCoordinates)) {
         return;
-    } else if (field->isOccupied(nextCoordinates)) {
-        Entity* entity = (Entity*)field->getPawn(nextCoordinates);
-        if (entity->type == Type::WALL) {
+    }
+    Type target = field->typeAt(nextCoordinates);
+    if (target == Type::EMPTY) {
+        field->movePawn(this, nextCoordinates);
+        coordinates = nextCoordinates;
+        return;
+    }
+    Entity* entity = (Entity*)field->getPawn(nextCoordinates);
+    switch (target) {
+        case Type::WALL: {
             Wall* wall = (Wall*)entity;
-            wall->strength--;
-            if (wall->strength == 0) {
-                wall->setSymbol('@'); // Change the symbol to '@' to indicate that the wall was destroyed
-                field->rePrintPawn(wall); // It will be reprinted in the next frame and then removed because of (strength == 0)
-            }
-        } else if (entity->type == Type::CHEST) {
+            wall->damage(1);
+            break;
+        }
+        case Type::CHEST: {
             Chest *chest = (Chest*)entity;
             if (chest->inventory.eggs == 0) {
                 // if there is no egg in the chest, the archer is angry and destroys the chest
@@ -2029,84 +3158,126 @@ void Archer::move() {
             } else {
                 chest->inventory.eggs--; // The archer eats the egg
             }
-        } else if (entity->type == Type::MINE) {
-            Mine* mine = (Mine*)entity;
-            mine->triggered = true;
-        } else if (entity->type == Type::TRAP || entity->type == Type::GATE) {
+            break;
+        }
+        case Type::MINE:
+            ((Mine*)entity)->triggered = true;
+            break;
+        case Type::TRAP: case Type::GATE:
             // The archer can't pass through the gate and the trap is too small to be triggered
-        } else if (entity->type == Type::WEASEL) {
-            // The weasel is scared and runs away
-            Weasel* weasel = (Weasel*)entity;
-            for (int j=0; j<3; j++) {
-                sista::Coordinates nextCoordinates_ = weasel->getCoordinates() + directionMap[(Direction)(rand() % 4)];
-                if (field->isFree(nextCoordinates_)) {
-                    field->movePawn(weasel, nextCoordinates_);
-                    weasel->setCoordinates(nextCoordinates_);
-                    return;
-                }
-            }
-        } else if (entity->type == Type::SNAKE) {
-            // The snake is scared and moves randomly
-            Snake* snake = (Snake*)entity;
-            for (int j=0; j<3; j++) {
-                sista::Coordinates nextCoordinates_ = snake->getCoordinates() + directionMap[(Direction)(rand() % 4)];
-                if (field->isFree(nextCoordinates_)) {
-                    field->movePawn(snake, nextCoordinates_);
-                    snake->setCoordinates(nextCoordinates_);
-                    return;
-                }
-            }
-        } else if (entity->type == Type::CHICKEN) {
-            // The chicken is scared and moves randomly
-            Chicken* chicken = (Chicken*)entity;
+            break;
+        case Type::WEASEL: case Type::SNAKE: case Type::CHICKEN:
+            // The animal is scared and moves randomly
             for (int j=0; j<3; j++) {
-                sista::Coordinates nextCoordinates_ = chicken->getCoordinates() + directionMap[(Direction)(rand() % 4)];
+                sista::Coordinates nextCoordinates_ = entity->getCoordinates() + directionMap[(Direction)mobStream().below(4)];
                 if (field->isFree(nextCoordinates_)) {
-                    field->movePawn(chicken, nextCoordinates_);
-                    chicken->setCoordinates(nextCoordinates_);
+                    field->movePawn(entity, nextCoordinates_);
+                    entity->setCoordinates(nextCoordinates_);
                     return;
                 }
             }
-        } else if (entity->type == Type::EGG) {
+            break;
+        case Type::EGG:
             // The egg is broken when the archer accidentally steps on it
             Egg::removeEgg((Egg*)entity);
             if (field->isFree(nextCoordinates)) {
                 field->movePawn(this, nextCoordinates);
                 coordinates = nextCoordinates;
             }
-        }
-    } else if (field->isFree(nextCoordinates)) {
-        field->movePawn(this, nextCoordinates);
-        coordinates = nextCoordinates;
+            break;
+        default:
+            break;
     }
 }
 void Archer::shoot() {
-    Direction direction;;
+    // Only along the row or the column of the player, and only when no wall or gate is in the way
     sista::Coordinates playerCoordinates = Player::player->getCoordinates();
+    if (!field->clearLine(coordinates, playerCoordinates)) return;
+    Direction direction;
     if (playerCoordinates.x == coordinates.x) {
         // The arrow will be shot in the y direction towards the player
         if (playerCoordinates.y < coordinates.y)
             direction = Direction::UP;
         else
             direction = Direction::DOWN;
-    } else if (playerCoordinates.y == coordinates.y) {
+    } else {
         if (playerCoordinates.x < coordinates.x)
             direction = Direction::LEFT;
         else
             direction = Direction::RIGHT;
-    } else {
-        direction = (Direction)(rand() % 4);
     }
     sista::Coordinates nextCoordinates = coordinates + directionMap[direction];
     if (field->isFree(nextCoordinates)) {
-        EnemyBullet::enemyBullets.push_back(std::make_shared<EnemyBullet>(nextCoordinates, direction));
-        field->addPrintPawn(EnemyBullet::enemyBullets.back());
+        spawn(EnemyBullet::enemyBullets, makePooled<EnemyBullet>(nextCoordinates, direction));
     } else {
         // For the moment I would just give up this option, because the player doesn't know what's going on
     }
 }
 
 
+#if DEBUG
+void checkRegistry() {
+    // Every pawn on the field must be tracked by its entity vector...
+    for (unsigned short j=0; j<worldHeight; j++) {
+        for (unsigned short i=0; i<worldWidth; i++) {
+            Entity* pawn = (Entity*)field->getPawn(j, i);
+            if (pawn == nullptr) continue;
+            if (!pawn->registered) {
+                debug << "Orphan " << pawn << " at {" << j << ", " << i << "}" << std::endl;
+                debug << "\t" << typeid(*pawn).name() << std::endl;
+            }
+        }
+    }
+    // ...the mines around every cell must match its watchers...
+    for (unsigned short j=0; j<worldHeight; j++) {
+        for (unsigned short i=0; i<worldWidth; i++) {
+            if (field->isOutOfBounds(j, i)) continue;
+            int mines = 0;
+            for (int dy=-1; dy<=1; dy++) {
+                for (int dx=-1; dx<=1; dx++) {
+                    if (field->typeAt(j + dy, i + dx) == Type::MINE) mines++;
+                }
+            }
+            if (mines != field->watchersAt(j, i)) {
+                debug << "Watchers at {" << j << ", " << i << "} are " << field->watchersAt(j, i) << " instead of " << mines << std::endl;
+            }
+            // ...and so must its line of sight bits, seen from the cells on both sides
+            if (j == 0 || i == 0 || j + 1 == worldHeight || i + 1 == worldWidth) continue;
+            bool blocking = field->typeAt(j, i) == Type::WALL || field->typeAt(j, i) == Type::GATE;
+            if (field->clearLine({j, (unsigned short)(i - 1)}, {j, (unsigned short)(i + 1)}) == blocking ||
+                field->clearLine({(unsigned short)(j - 1), i}, {(unsigned short)(j + 1), i}) == blocking) {
+                debug << "Line of sight at {" << j << ", " << i << "} is wrong" << std::endl;
+            }
+        }
+    }
+    // ...and every tracked entity must be where it thinks it is
+    auto check = [](const auto& entities) {
+        for (const auto& entity : entities) {
+            sista::Coordinates coordinates = entity->getCoordinates();
+            if (!entity->registered) {
+                debug << "Unregistered " << entity.get() << " still tracked" << std::endl;
+            } else if (field->getPawn(coordinates) != entity.get()) {
+                debug << "Misplaced " << entity.get() << " at {" << coordinates.y << ", " << coordinates.x << "}" << std::endl;
+                debug << "\t" << typeid(*entity).name() << std::endl;
+            }
+        }
+    };
+    check(Bullet::bullets);
+    check(EnemyBullet::enemyBullets);
+    check(Archer::archers);
+    check(Walker::walkers);
+    check(Wall::walls);
+    check(Mine::mines);
+    check(Gate::gates);
+    check(Weasel::weasels);
+    check(Snake::snakes);
+    check(Chicken::chickens);
+    check(Egg::eggs);
+    check(Chest::chests);
+    check(Trap::traps);
+}
+#endif
+
 void removeNullptrs(std::vector<std::shared_ptr<Entity>>& entities) {
     for (unsigned i=0; i<entities.size(); i++) {
         if (entities[i] == nullptr) {
@@ -1,7 +1,21 @@
 #include <sista/sista.hpp>
+#include "slotmap.hpp"
+#include "random.hpp"
+#include "wheel.hpp"
+#include "pool.hpp"
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <random>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <array>
+#include <memory>
+#include <functional>
+#include <atomic>
 
 
 enum Type {
@@ -23,13 +37,15 @@ enum Type {
 
     CHICKEN, // %, will lay eggs
     EGG, // 0, will hatch into a chicken
+
+    EMPTY, // No pawn, only used by the occupancy grid of World
 };
 
 
 enum Direction {UP, RIGHT, DOWN, LEFT};
 extern std::unordered_map<Direction, sista::Coordinates> directionMap;
 extern std::unordered_map<Direction, char> directionSymbol;
-extern std::mt19937 rng;
+extern RandomStreams rng;
 
 extern sista::ANSISettings nightPlayerStyle;
 
@@ -45,12 +61,105 @@ struct Inventory {
 class Entity : public sista::Pawn {
 public:
     Type type;
+    bool registered = false; // If the entity is tracked by its slot map (or is the player), kept by spawn() and the removeX()
+    Handle handle; // Position in the slot map of its class
 
     Entity();
     Entity(char, sista::Coordinates, sista::ANSISettings&, Type);
+
+    char glyph() const { return symbol; }
+    const sista::ANSISettings& style() const { return settings; }
 };
 
 
+#define CHUNK_SHIFT 5
+#define CHUNK_SIZE (1 << CHUNK_SHIFT) // Cells per side of a chunk
+static_assert(CHUNK_SIZE <= 32, "A row or a column of a chunk must fit in a sight word");
+
+struct Chunk {
+    std::array<uint8_t, CHUNK_SIZE * CHUNK_SIZE> types; // Type of the pawn in each cell, row after row
+    std::array<std::shared_ptr<sista::Pawn>, CHUNK_SIZE * CHUNK_SIZE> pawns;
+    std::array<uint8_t, CHUNK_SIZE * CHUNK_SIZE> watchers; // Mines in the 3x3 block around each cell
+    std::array<uint64_t, CHUNK_SIZE * CHUNK_SIZE / 64> freeCells; // One bit per empty cell inside the world
+    int freeCount = 0;
+    std::array<uint32_t, CHUNK_SIZE> rowSight; // One bit per wall or gate in each row
+    std::array<uint32_t, CHUNK_SIZE> columnSight; // The same bits, in each column
+
+    Chunk();
+}; // A square of the world, allocated when it is generated
+
+
+class World {
+    int width;
+    int height;
+    int chunksWide;
+    int chunksHigh;
+    std::vector<std::unique_ptr<Chunk>> chunks; // Row after row, nullptr until generated
+
+    Chunk* chunkAt(unsigned short, unsigned short) const; // nullptr if out of the world or not generated
+    static int cellIndex(unsigned short y, unsigned short x) { return (y & (CHUNK_SIZE - 1)) * CHUNK_SIZE + (x & (CHUNK_SIZE - 1)); }
+    void watch(sista::Coordinates, int, Chunk* = nullptr); // Adds to the watchers of the 3x3 block around a mine, only in the given chunk if any
+    void arrive(sista::Pawn*); // Called whenever a pawn gets to a cell, walkers and archers trigger the mines around
+    void sight(sista::Coordinates, Type, bool); // Sets or clears the line of sight bits of a wall or a gate
+    void markFree(Chunk*, int, bool);
+    void resetFree(int); // Every cell of the chunk with that index that is inside the world
+
+public:
+    bool lazy; // Chunks are generated when the player gets close, instead of all at once
+    bool printing = true; // Print every change right away like Sista does, until the renderer takes over
+    int activeTop = 0, activeLeft = 0, activeHeight, activeWidth; // Generated cells around the player, where new entities appear
+    std::atomic<uint32_t> blockers{0}; // Bumped when a wall, gate, chest, trap or mine comes or goes, and when a chunk is generated
+
+    World(int, int, bool);
+
+    Type typeAt(sista::Coordinates) const; // The coordinates must be in bounds, EMPTY where not generated
+    Type typeAt(unsigned short, unsigned short) const;
+
+    sista::Pawn* getPawn(sista::Coordinates&) const;
+    sista::Pawn* getPawn(unsigned short, unsigned short) const;
+    bool isOutOfBounds(sista::Coordinates&) const; // Chunks not generated yet count as outside the world
+    bool isOutOfBounds(unsigned short, unsigned short) const;
+    bool isOccupied(sista::Coordinates&) const;
+    bool isFree(sista::Coordinates&) const;
+    bool isFree(unsigned short, unsigned short) const;
+    int watchersAt(unsigned short, unsigned short) const; // Mines around the cell, 0 where not generated
+    bool clearLine(sista::Coordinates, sista::Coordinates) const; // Same row or column and no wall or gate in between
+    bool randomFreeCell(int, int, int, int, Random&, sista::Coordinates&) const; // Uniform among the empty cells of a chunk aligned area, false if there are none
+
+    void addPrintPawn(std::shared_ptr<sista::Pawn>);
+    void movePawn(sista::Pawn*, sista::Coordinates&);
+    void erasePawn(sista::Pawn*);
+    void rePrintPawn(sista::Pawn*);
+    void swapTwoPawns(sista::Pawn*, sista::Pawn*);
+    void print(); // Every pawn, like Sista's Field::print()
+    void clear(); // Removes every pawn, generated chunks stay generated
+
+    bool generate(int, int); // Allocates the chunk at that chunk row and column, false if it already was
+    std::vector<uint32_t> generatedChunks() const; // Indices, row after row
+    int chunkColumns() const { return chunksWide; }
+    int chunkRows() const { return chunksHigh; }
+}; // The field, stored in chunks with a compact type-per-cell grid, so collisions don't have to chase pawn pointers
+
+
+#define FLOW_RADIUS 40 // Cells around the player where walkers find their way, farther they use the greedy rule
+
+class FlowField {
+    sista::Coordinates source;
+    uint32_t seen = 0; // World::blockers when the distances were computed
+    bool computed = false;
+    int top = 0, left = 0, size = 0; // Square window centered on the source
+    std::vector<uint16_t> distance; // Steps to the source, row after row in the window
+    std::vector<uint32_t> frontier; // Breadth first queue, kept for its capacity
+
+public:
+    static constexpr uint16_t UNREACHABLE = UINT16_MAX;
+    static bool passable(Type); // Walls, gates, chests, traps and mines are walked around, whatever moves is not
+
+    void update(World*, sista::Coordinates); // Only recomputed when the source moved or a blocker changed
+    uint16_t at(sista::Coordinates) const; // UNREACHABLE outside of the window
+}; // Distance of every cell to the player, shared by all the walkers
+
+
 class Player : public Entity {
 public:
     static sista::ANSISettings playerStyle;
@@ -72,16 +181,16 @@ public:
 class Bullet : public Entity {
 public:
     static sista::ANSISettings bulletStyle;
-    static std::vector<std::shared_ptr<Bullet>> bullets;
+    static SlotMap<Bullet> bullets;
     Direction direction;
     unsigned short speed = 1; // The bullet moves speed cells per frame
-    bool collided = false; // If the bullet was destroyed in a collision with an opposite bullet
 
     Bullet();
     Bullet(sista::Coordinates, Direction);
     Bullet(sista::Coordinates, Direction, unsigned short);
 
-    void move();
+    sista::Coordinates target(); // Where the bullet is headed this tick
+    void hit(Entity*); // What was in the way, the bullet is removed afterwards
 
     static void removeBullet(Bullet*);
 };
@@ -90,30 +199,43 @@ public:
 class EnemyBullet : public Entity {
 public:
     static sista::ANSISettings enemyBulletStyle;
-    static std::vector<std::shared_ptr<EnemyBullet>> enemyBullets;
+    static SlotMap<EnemyBullet> enemyBullets;
     Direction direction;
     unsigned short speed = 1; // The bullet moves speed cells per frame
-    bool collided = false; // If the bullet was destroyed in a collision with an opposite bullet
 
     EnemyBullet();
     EnemyBullet(sista::Coordinates, Direction);
     EnemyBullet(sista::Coordinates, Direction, unsigned short);
 
-    void move();
+    sista::Coordinates target();
+    void hit(Entity*);
 
     static void removeEnemyBullet(EnemyBullet*);
 };
 
 
+struct Intent {
+    std::shared_ptr<Entity> mover; // Kept alive until the whole batch is applied
+    sista::Coordinates from;
+    sista::Coordinates to;
+    bool outOfBounds = false;
+    bool collided = false; // With another bullet, set by the resolve pass
+}; // Move of a bullet or a walker, chosen from the field as it was before any of them moved
+void moveProjectiles(); // Bullets and enemy bullets all move at once, whatever their order
+void moveWalkers(); // Walkers pick their steps at once, then take them, whatever their order
+
+
 class Wall : public Entity {
 public:
     static sista::ANSISettings wallStyle;
-    static std::vector<std::shared_ptr<Wall>> walls;
+    static SlotMap<Wall> walls;
     short int strength; // The wall has a certain strength (when it reaches 0, the wall is destroyed)
 
     Wall();
     Wall(sista::Coordinates, short int);
 
+    void damage(short int); // Once its strength runs out it crumbles, and it is removed at the next tick
+
     static void removeWall(Wall*);
 };
 
@@ -121,17 +243,15 @@ public:
 class Mine : public Entity {
 public:
     static sista::ANSISettings mineStyle;
-    static std::vector<std::shared_ptr<Mine>> mines;
-    bool triggered = false;
-    bool alive = true;
+    static SlotMap<Mine> mines;
+    bool triggered = false; // It will explode at the start of the next tick
 
     Mine();
     Mine(sista::Coordinates);
 
-    bool checkTrigger();
     void trigger();
-    void explode();
 
+    static void explodeTriggered(); // With every mine caught in the blasts, as a single batch
     static void removeMine(Mine*);
 };
 
@@ -139,7 +259,7 @@ public:
 class Chest : public Entity {
 public:
     static sista::ANSISettings chestStyle;
-    static std::vector<std::shared_ptr<Chest>> chests;
+    static SlotMap<Chest> chests;
     Inventory inventory;
 
     Chest();
@@ -153,7 +273,7 @@ public:
 class Trap : public Entity {
 public:
     static sista::ANSISettings trapStyle;
-    static std::vector<std::shared_ptr<Trap>> traps;
+    static SlotMap<Trap> traps;
 
     Trap();
     Trap(sista::Coordinates);
@@ -165,13 +285,14 @@ public:
 class Walker : public Entity {
 public:
     static sista::ANSISettings walkerStyle;
-    static std::vector<std::shared_ptr<Walker>> walkers;
+    static SlotMap<Walker> walkers;
     static std::bernoulli_distribution movingDistribution;
 
     Walker();
     Walker(sista::Coordinates);
 
-    void move();
+    sista::Coordinates target(); // The cell it heads to, without changing anything
+    void step(sista::Coordinates); // Into that cell, or acts on what is there
 
     static void removeWalker(Walker*);
 };
@@ -180,9 +301,10 @@ public:
 class Archer : public Entity {
 public:
     static sista::ANSISettings archerStyle;
-    static std::vector<std::shared_ptr<Archer>> archers;
+    static SlotMap<Archer> archers;
     static std::bernoulli_distribution movingDistribution;
-    static std::bernoulli_distribution shootDistribution;
+    static std::bernoulli_distribution shootDistribution; // Per tick, sampled as the ticks until the next shot
+    uint32_t shotTick = 0; // When it shoots next, 0 until it is scheduled
 
     Archer();
     Archer(sista::Coordinates);
@@ -197,9 +319,10 @@ public:
 class Chicken : public Entity {
 public:
     static sista::ANSISettings chickenStyle;
-    static std::vector<std::shared_ptr<Chicken>> chickens;
+    static SlotMap<Chicken> chickens;
     static std::bernoulli_distribution movingDistribution;
-    static std::bernoulli_distribution eggDistribution;
+    static std::bernoulli_distribution eggDistribution; // Per move, sampled as the moves until the next egg
+    uint32_t movesToEgg = 0; // Successful moves left before laying, 0 until it is drawn
 
     Chicken();
     Chicken(sista::Coordinates);
@@ -213,8 +336,9 @@ public:
 class Egg : public Entity {
 public:
     static sista::ANSISettings eggStyle;
-    static std::vector<std::shared_ptr<Egg>> eggs;
+    static SlotMap<Egg> eggs;
     static std::bernoulli_distribution hatchingDistribution;
+    uint32_t hatchTick = 0; // When it hatches by itself, 0 until it is scheduled
 
     Egg();
     Egg(sista::Coordinates);
@@ -226,7 +350,7 @@ public:
 class Weasel : public Entity {
 public:
     static sista::ANSISettings weaselStyle;
-    static std::vector<std::shared_ptr<Weasel>> weasels;
+    static SlotMap<Weasel> weasels;
     bool crossed = false; // If the weasel has reached the other side of the field and will be removed
     bool caught = false; // If the weasel was caught in a trap
     Direction direction;
@@ -243,7 +367,7 @@ public:
 class Snake : public Entity {
 public:
     static sista::ANSISettings snakeStyle;
-    static std::vector<std::shared_ptr<Snake>> snakes;
+    static SlotMap<Snake> snakes;
     bool crossed = false; // If the snake has reached the other side of the field and will be removed
     Direction direction;
 
@@ -259,7 +383,7 @@ public:
 class Gate : public Entity {
 public:
     static sista::ANSISettings gateStyle;
-    static std::vector<std::shared_ptr<Gate>> gates;
+    static SlotMap<Gate> gates;
     // bool open = false; // Redundant, open at day, closed at night
 
     Gate();
@@ -268,12 +392,235 @@ public:
     static void removeGate(Gate*);
 };
 
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+}; // Swallows everything Sista prints while running --headless
+
+struct Cell {
+    char symbol = ' ';
+    sista::ForegroundColor foreground{};
+    sista::BackgroundColor background{};
+    sista::Attribute attribute{};
+
+    bool sameStyle(const Cell& other) const {
+        return foreground == other.foreground && background == other.background && attribute == other.attribute;
+    }
+    bool operator==(const Cell& other) const { return symbol == other.symbol && sameStyle(other); }
+    bool operator!=(const Cell& other) const { return !(*this == other); }
+}; // What the terminal shows in a cell of the field, a free cell is the default one
+
+
+class FrameBuffer : public std::streambuf {
+    std::vector<char> buffer; // Reused frame after frame
+
+protected:
+    int overflow(int) override;
+
+public:
+    size_t bytes = 0; // Sent by the last send()
+    unsigned writes = 0; // System calls made by the last send()
+
+    FrameBuffer(size_t);
+
+    void send(); // Hands everything collected to the terminal at once
+}; // Collects the escape sequences of a whole frame
+
+
+class Renderer {
+    int width; // Of the viewport, not of the world
+    int height;
+    sista::Coordinates origin; // World cell shown in the top left corner of the viewport
+    std::vector<Cell> front; // What the terminal is showing
+    std::vector<Cell> back; // What the field looks like now
+    std::streambuf* terminal;
+    NullBuffer nullBuffer;
+
+    void capture();
+
+public:
+    FrameBuffer frame;
+
+    Renderer(int, int);
+
+    void mute(); // Sista prints on every move, its output is dropped while muted
+    void unmute(); // What is printed goes into the frame, until send()
+    void send();
+    void restore(); // Gives std::cout back its terminal
+    void follow(sista::Coordinates); // Centers the viewport on the target, without showing anything outside the world
+    void resync(); // Clears the screen and prints the border and the whole viewport, must be unmuted
+    void present(); // Prints only the cells that changed since the last call, must be unmuted
+}; // Keeps a copy of the viewport on the terminal to only send what changed
+
+
+class Scheduler {
+public:
+    enum class Policy {
+        CATCH_UP, // Late ticks run back to back until the schedule is met again
+        SKIP // Late ticks are dropped, the game slows down instead
+    };
+
+    unsigned long missed = 0; // Ticks that started after their deadline
+    unsigned long skipped = 0; // Ticks dropped, by SKIP or by CATCH_UP when too far behind
+    std::chrono::steady_clock::duration worstLateness{0};
+    bool late = false; // If the last tick is running to catch up
+
+    Scheduler(double, Policy);
+
+    void setRate(double); // In ticks per second
+    void reset(); // Forget about delays, the next tick is one period from now
+    void wait(); // Until the deadline of the next tick
+
+private:
+    Policy policy;
+    std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::time_point deadline;
+}; // Fixed timestep on steady_clock deadlines, so the day lasts the same under load
+
+
+#define REPLAY_MAGIC "INRP"
+#define REPLAY_VERSION 2 // 2 added the size of the world
+
+class Replay {
+public:
+    enum class Mode {OFF, RECORD, PLAY};
+    struct Event {
+        uint32_t tick;
+        char key;
+        bool lycanthropy; // Picked by the game at night, not typed by the player
+    };
+
+    Mode mode = Mode::OFF;
+    uint64_t seed = 0;
+    int width = 0; // Of the world, as the seed alone doesn't make the same game on another size
+    int height = 0;
+    std::vector<Event> events; // Only filled when playing
+    unsigned long desyncs = 0; // Lycanthropy keys that differ from the recorded ones
+
+    bool start(const char*, uint64_t); // Writes the header, every record() call is then appended
+    bool load(const char*); // Reads the whole file, the run must then use its seed
+    void record(uint32_t, char, bool=false);
+    void feed(uint32_t); // Applies the keys recorded for this tick
+    void check(uint32_t, char); // Compares a lycanthropy key with the recorded one
+    bool finished() const { return cursor == events.size(); }
+
+private:
+    std::ofstream file;
+    uint32_t lastTick = 0;
+    size_t cursor = 0;
+}; // (tick, key) log, with a fixed seed it plays the same game again
+
+
+#define SNAPSHOT_MAGIC "INSV"
+#define SNAPSHOT_VERSION 6 // 2 added the generated chunks, 3 dropped the collided flag of bullets, 4 the alive flag of mines, 5 added the timers, 6 the tick of the next daylight switch
+#define SAVE_FILE "inomhus.sav" // Where 'x' saves when --save was not given
+
+void applyDaylight(); // Player and border styles for the current day or night
+bool saveGame(const char*, uint32_t); // Tick is the next one to run
+bool loadGame(const char*, uint32_t&); // Into an empty field, false if the file is not a valid snapshot
+bool readSnapshotSize(const char*, int&, int&); // The world must be created with this size before loadGame()
+
+
+void lose(const char*);
+int runHeadless(int, uint32_t);
+void tick(int);
+extern World* field;
+
+#define REGION_HEIGHT CHUNK_SIZE // Rows of the field in each region, updated by one worker at a time
+#define REGION_MARGIN 2 // Mobs can reach this far, so the ones closer to another region are updated after the parallel pass
+#define REGION_STREAM 16 // Stream of the first region, past the ones of RandomStreams
+
+struct Change {
+    void (*apply)(Change&); // insertSpawned<T> or eraseDespawned<T>
+    void* entities; // The SlotMap<T> of the entity
+    Entity* entity;
+    std::shared_ptr<Entity> owner; // Of the spawned ones, so they outlive the pass even if removed during it
+}; // Slot map change made during a parallel pass, a plain record so that deferring it allocates nothing
+
+struct Region {
+    Random random; // Seeded again every tick from the seed, the tick and the region, so the thread count doesn't matter
+    std::vector<Change> deferred; // Slot map changes, applied in region order once all the regions are done
+    std::vector<std::pair<uint32_t, std::function<void()>>> delayed; // Events from after(), added to the wheel with the changes
+}; // Horizontal strip of the field whose inner mobs are updated in parallel with the other regions
+
+extern thread_local Region* region; // The one this thread is updating, nullptr outside of the parallel passes
+Random& mobStream(); // Of the current region, or rng.mobs when updating sequentially
+Random& combatStream(); // Same, rng.combat when updating sequentially
+void seedRegions(uint32_t); // At the start of the mob updates of every tick
+
+#define TIMER_BUCKETS 1024 // Ticks covered by one lap of the timer wheel, later events wait in their bucket
+
+struct Timer {
+    Type type;
+    Handle handle; // Stale once the entity is removed, then the timer is dropped when due
+}; // Rare event of an entity, kept in the timer wheel at the tick it happens
+
+extern TimerWheel<Timer, TIMER_BUCKETS> timers;
+extern uint32_t currentTick; // Of the tick being run, or of the last one between ticks
+inline void schedule(Entity*) {} // Most entities have no timer
+void schedule(Egg*); // Draws the tick it hatches by itself, unless it already has one
+void schedule(Archer*); // Draws the tick it shoots next, unless it already has one
+void schedule(Chicken*); // Draws the moves before its next egg, unless it already has them
+void schedule(Wall*); // Removes it at the next tick if it has crumbled
+void fireTimers(uint32_t); // Hatches the eggs and lets the archers shoot when they are due
+
+extern TimerWheel<std::function<void()>, TIMER_BUCKETS> events; // Delayed and periodic work of the engine
+void after(uint32_t, std::function<void()>); // At the start of the tick that many ticks from now, at least the next one
+void every(uint32_t, std::function<void()>); // At the start of every tick that is a multiple of the period
+void scheduleEvents(); // The periodic ones, events are not part of snapshots so their owners schedule them again
+void fireEvents(uint32_t);
+
+template <typename T>
+void insertSpawned(Change& change) {
+    T* pawn = static_cast<T*>(change.entity);
+    pawn->handle = static_cast<SlotMap<T>*>(change.entities)->insert(std::static_pointer_cast<T>(change.owner));
+    schedule(pawn);
+}
+template <typename T>
+void eraseDespawned(Change& change) {
+    static_cast<SlotMap<T>*>(change.entities)->erase(static_cast<T*>(change.entity)->handle);
+}
+
+template <typename T>
+T* spawn(SlotMap<T>& entities, std::shared_ptr<T> entity) {
+    T* pawn = entity.get();
+    pawn->registered = true;
+    field->addPrintPawn(entity);
+    if (region != nullptr) {
+        region->deferred.push_back(Change{&insertSpawned<T>, &entities, pawn, std::move(entity)});
+    } else {
+        pawn->handle = entities.insert(std::move(entity));
+        schedule(pawn);
+    }
+    return pawn;
+} // Tracks the entity in its slot map and prints it on the field
+
+template <typename T>
+void despawn(SlotMap<T>& entities, T* entity) {
+    if (!entity->registered) return;
+    field->erasePawn(entity);
+    entity->registered = false;
+    if (region != nullptr) {
+        region->deferred.push_back(Change{&eraseDespawned<T>, &entities, entity, nullptr});
+    } else {
+        entities.erase(entity->handle); // Last, as it may destroy the entity
+    }
+} // Removes the entity from the field and stops tracking it, does nothing if it was already removed
+
+void checkRegistry();
 void input();
+void drainKeys(int, bool);
+extern Replay replay;
 void act(char);
 void printIntro();
 void tutorial();
-void printSideInstructions(int, int, int);
-void populate(sista::SwappableField*);
-void repopulate(sista::SwappableField*);
-void spawnNew(sista::SwappableField*);
+void printSideInstructions(int, int); // With the ticks left before the night or the day
+void printInstructions();
+void printBorder(int, int); // Around a viewport of the given height and width
+void populate(World*);
+void populateChunk(World*, int, int, sista::Coordinates); // Same as populate(), for a single chunk just generated
+void generateAround(World*, sista::Coordinates); // Generates the chunks close to the coordinates
+void repopulate(World*);
+void spawnNew(World*);
 void removeNullptrs(std::vector<std::shared_ptr<Entity>>&);
\ No newline at end of file
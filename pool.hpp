@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+template <size_t Size, size_t Align>
+class BlockPool {
+    union Block {
+        Block* next; // While free
+        alignas(Align) unsigned char bytes[Size];
+    };
+
+    static constexpr size_t SLAB = 256; // Blocks allocated at once when the free list runs out
+
+    std::mutex mutex_; // Eggs are laid from the worker threads
+    Block* free_ = nullptr;
+    std::vector<std::unique_ptr<Block[]>> slabs_;
+
+    void grow() {
+        slabs_.emplace_back(new Block[SLAB]);
+        Block* slab = slabs_.back().get();
+        for (size_t k=SLAB; k-->0;) {
+            slab[k].next = free_;
+            free_ = &slab[k];
+        }
+    }
+
+public:
+    // Never destroyed, as the static slot maps release their entities after any other static is gone
+    static BlockPool& instance() {
+        static BlockPool* pool = new BlockPool();
+        return *pool;
+    }
+
+    void* allocate() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_ == nullptr) grow();
+        Block* block = free_;
+        free_ = block->next;
+        return block;
+    }
+
+    void deallocate(void* pointer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Block* block = static_cast<Block*>(pointer);
+        block->next = free_;
+        free_ = block;
+    }
+}; // Free list of same-sized blocks carved out of slabs, which are kept until the end so memory stays flat
+
+
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) return std::allocator<T>().allocate(n);
+        return static_cast<T*>(BlockPool<sizeof(T), alignof(T)>::instance().allocate());
+    }
+
+    void deallocate(T* pointer, size_t n) {
+        if (n != 1) return std::allocator<T>().deallocate(pointer, n);
+        BlockPool<sizeof(T), alignof(T)>::instance().deallocate(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+}; // Stateless, every allocation of one object goes to the pool of its size
+
+
+// Like std::make_shared, with the object and its control block in a single pooled block
+template <typename T, typename... Args>
+std::shared_ptr<T> makePooled(Args&&... args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
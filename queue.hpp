@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+
+// Capacity must be a power of two, one slot is always left empty to tell full from empty
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    T buffer_[N];
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to pop, only written by the consumer
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to push, only written by the producer
+
+public:
+    // Producer side, returns false and drops the value when the consumer is too far behind
+    bool push(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) & (N - 1);
+        if (next == head_.load(std::memory_order_acquire)) return false;
+        buffer_[tail] = value;
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false when there is nothing to pop
+    bool pop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = buffer_[head];
+        head_.store((head + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+}; // Lock-free ring between exactly one producer thread and one consumer thread
@@ -0,0 +1,83 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+class Random {
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    using result_type = uint64_t;
+
+    Random(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+
+    // Different streams of the same seed are unrelated, so one subsystem drawing more numbers does not shift the others
+    void reseed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t state = seed ^ (stream * 0xd1342543de82ef95ULL);
+        for (uint64_t& word : s) word = splitmix64(state);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound), multiply-shift instead of the biased and slower modulo
+    uint32_t below(uint32_t bound) {
+        return (uint32_t)((((*this)() >> 32) * bound) >> 32);
+    }
+
+    // Uniform in (0, 1], never 0 so that its logarithm is finite
+    double unit() {
+        return (double)(((*this)() >> 11) + 1) * 0x1.0p-53;
+    }
+
+    // Number of Bernoulli(p) trials up to and including the first success, drawn at once by inverting the CDF
+    uint32_t geometric(double p) {
+        if (p >= 1) return 1;
+        if (p <= 0) return UINT32_MAX;
+        double trials = std::floor(std::log(unit()) / std::log1p(-p)) + 1;
+        return trials < (double)UINT32_MAX ? (uint32_t)trials : UINT32_MAX;
+    }
+
+    const uint64_t* state() const { return s; }
+    void setState(const uint64_t* state) { for (int i=0; i<4; i++) s[i] = state[i]; }
+}; // xoshiro256**, small, fast and usable as UniformRandomBitGenerator by the std distributions
+
+
+struct RandomStreams {
+    uint64_t seed = 0;
+    Random world; // populate() and spawnNew()
+    Random mobs; // Movement of chickens, walkers and archers, eggs hatching
+    Random combat; // Archers aiming, mines damaging walls
+    Random player; // Lycanthropy and hatching eggs by hand
+
+    void reseed(uint64_t seed_) {
+        seed = seed_;
+        world.reseed(seed, 1);
+        mobs.reseed(seed, 2);
+        combat.reseed(seed, 3);
+        player.reseed(seed, 4);
+    }
+}; // One engine-owned generator per subsystem, all derived from the --seed
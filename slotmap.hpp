@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+struct Handle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+}; // Stays valid until its entity is erased, then every copy of it goes stale
+
+
+template <typename T>
+class SlotMap {
+    struct Slot {
+        uint32_t dense; // Position in the dense array when in use, next free slot otherwise
+        uint32_t generation = 0; // Bumped on every erase so old handles stop matching
+    };
+
+    std::vector<std::shared_ptr<T>> dense_; // Packed, iterated every frame
+    std::vector<uint32_t> owners_; // Slot of each dense element, needed to patch the moved one on erase
+    std::vector<Slot> slots_;
+    uint32_t freeHead_ = UINT32_MAX;
+
+public:
+    using iterator = typename std::vector<std::shared_ptr<T>>::iterator;
+    using const_iterator = typename std::vector<std::shared_ptr<T>>::const_iterator;
+
+    Handle insert(std::shared_ptr<T> value) {
+        uint32_t index;
+        if (freeHead_ != UINT32_MAX) {
+            index = freeHead_;
+            freeHead_ = slots_[index].dense;
+        } else {
+            index = (uint32_t)slots_.size();
+            slots_.push_back(Slot{0, 0});
+        }
+        slots_[index].dense = (uint32_t)dense_.size();
+        dense_.push_back(std::move(value));
+        owners_.push_back(index);
+        return Handle{index, slots_[index].generation};
+    }
+
+    bool contains(Handle handle) const {
+        return handle.index < slots_.size() && slots_[handle.index].generation == handle.generation;
+    }
+
+    T* get(Handle handle) const {
+        return contains(handle) ? dense_[slots_[handle.index].dense].get() : nullptr;
+    }
+
+    // Swaps the last element into the hole, so the order of iteration is not preserved
+    bool erase(Handle handle) {
+        if (!contains(handle)) return false;
+        Slot& slot = slots_[handle.index];
+        uint32_t hole = slot.dense;
+        uint32_t last = (uint32_t)dense_.size() - 1;
+        if (hole != last) {
+            dense_[hole] = std::move(dense_[last]);
+            owners_[hole] = owners_[last];
+            slots_[owners_[hole]].dense = hole;
+        }
+        dense_.pop_back();
+        owners_.pop_back();
+        slot.generation++;
+        slot.dense = freeHead_;
+        freeHead_ = handle.index;
+        return true;
+    }
+
+    // Visits every element once, even when the visitor erases the element it was given
+    template <typename F>
+    void forEach(F visit) {
+        for (size_t i=0; i<dense_.size(); i++) {
+            T* element = dense_[i].get();
+            visit(element);
+            if (i < dense_.size() && dense_[i].get() != element) i--; // The last one was swapped in
+        }
+    }
+
+    void clear() {
+        while (!dense_.empty()) {
+            erase(Handle{owners_.back(), slots_[owners_.back()].generation});
+        }
+    }
+
+    void reserve(size_t capacity) {
+        dense_.reserve(capacity);
+        owners_.reserve(capacity);
+        slots_.reserve(capacity);
+    }
+
+    size_t size() const { return dense_.size(); }
+    bool empty() const { return dense_.empty(); }
+    std::shared_ptr<T>& operator[](size_t i) { return dense_[i]; }
+    const std::shared_ptr<T>& operator[](size_t i) const { return dense_[i]; }
+    std::shared_ptr<T>& back() { return dense_.back(); }
+    iterator begin() { return dense_.begin(); }
+    iterator end() { return dense_.end(); }
+    const_iterator begin() const { return dense_.begin(); }
+    const_iterator end() const { return dense_.end(); }
+}; // O(1) insert and erase through generational handles, dense storage for iteration
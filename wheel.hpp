@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+template <typename T, size_t N>
+class TimerWheel {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "The number of buckets must be a power of two");
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        uint32_t tick;
+        uint32_t next; // In its bucket, or in the free list
+        T value;
+    };
+
+    struct Bucket {
+        uint32_t head = NONE;
+        uint32_t tail = NONE; // Entries are appended, so a bucket gives them back in order
+    };
+
+    std::vector<Node> nodes_; // Grows to the most entries ever pending, then freed nodes are reused
+    uint32_t free_ = NONE;
+    Bucket ticks_[N]; // Entries of the current lap of N ticks, one bucket per tick
+    Bucket laps_[N]; // Later entries, one bucket per lap; the ones N laps away or more wait for theirs
+    uint32_t lap_ = 0; // Of the last tick taken
+    size_t size_ = 0;
+
+    void append(Bucket& bucket, uint32_t node) {
+        nodes_[node].next = NONE;
+        if (bucket.tail == NONE) {
+            bucket.head = node;
+        } else {
+            nodes_[bucket.tail].next = node;
+        }
+        bucket.tail = node;
+    }
+
+    void release(uint32_t node) {
+        nodes_[node].value = T();
+        nodes_[node].next = free_;
+        free_ = node;
+        size_--;
+    }
+
+    // Moves the entries of the lap just begun down to the buckets of single ticks
+    void cascade(uint32_t lap) {
+        Bucket& bucket = laps_[lap % N];
+        uint32_t node = bucket.head;
+        bucket = Bucket();
+        while (node != NONE) {
+            uint32_t next = nodes_[node].next;
+            if (nodes_[node].tick / N == lap) {
+                append(ticks_[nodes_[node].tick % N], node);
+            } else {
+                append(bucket, node);
+            }
+            node = next;
+        }
+    }
+
+public:
+    void add(uint32_t tick, T value) {
+        uint32_t node;
+        if (free_ != NONE) {
+            node = free_;
+            free_ = nodes_[node].next;
+            nodes_[node].tick = tick;
+            nodes_[node].value = std::move(value);
+        } else {
+            node = (uint32_t)nodes_.size();
+            nodes_.push_back(Node{tick, NONE, std::move(value)});
+        }
+        append(tick / N == lap_ ? ticks_[tick % N] : laps_[(tick / N) % N], node);
+        size_++;
+    }
+
+    // Appends the values due at this tick to due; it has to see every tick, or the laps it skips are never cascaded
+    template <typename Container>
+    void take(uint32_t tick, Container& due) {
+        if (tick / N != lap_) {
+            lap_ = tick / N;
+            cascade(lap_);
+        }
+        Bucket& bucket = ticks_[tick % N];
+        uint32_t node = bucket.head;
+        bucket = Bucket();
+        while (node != NONE) {
+            uint32_t next = nodes_[node].next;
+            if (nodes_[node].tick == tick) due.push_back(std::move(nodes_[node].value)); // The others were due at a tick already gone
+            release(node);
+            node = next;
+        }
+    }
+
+    void clear() {
+        nodes_.clear();
+        free_ = NONE;
+        for (Bucket& bucket : ticks_) bucket = Bucket();
+        for (Bucket& bucket : laps_) bucket = Bucket();
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+}; // Two-level timing wheel: O(1) to schedule, and each tick only looks at its own bucket plus one cascade per lap
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkerPool {
+    std::vector<std::thread> threads_;
+    size_t workers_ = 0; // threads_.size(), but set before any of them starts
+    std::mutex mutex_;
+    std::condition_variable wake_; // Workers wait here for the next batch
+    std::condition_variable done_; // run() waits here for the batch to be over
+    std::function<void(size_t)> job_;
+    size_t jobs_ = 0;
+    std::atomic<size_t> next_{0}; // Next job index to hand out
+    size_t finished_ = 0; // Workers done with the current batch, every one of them takes part in each
+    unsigned long batch_ = 0; // Bumped by every run(), so a worker never takes the same batch twice
+    bool stopping_ = false;
+
+    // Takes jobs until there are none left, from any thread
+    void drain() {
+        for (size_t job; (job = next_.fetch_add(1, std::memory_order_relaxed)) < jobs_;) {
+            job_(job);
+        }
+    }
+
+    void work(unsigned long seen) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [&]() { return stopping_ || batch_ != seen; });
+            if (stopping_) return;
+            seen = batch_;
+            lock.unlock();
+            drain();
+            lock.lock();
+            if (++finished_ == workers_) done_.notify_one();
+        }
+    }
+
+public:
+    // The calling thread takes part in every batch, so it only starts threads - 1 workers
+    void start(unsigned threads) {
+        stop();
+        stopping_ = false;
+        workers_ = threads > 1 ? threads - 1 : 0;
+        for (unsigned t=1; t<threads; t++) {
+            threads_.emplace_back(&WorkerPool::work, this, batch_); // A late start must not miss the first batch
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& thread : threads_) thread.join();
+        threads_.clear();
+        workers_ = 0;
+    }
+
+    // Calls job(0) ... job(jobs - 1), in no particular order, and returns when all of them are done
+    void run(size_t jobs, std::function<void(size_t)> job) {
+        if (threads_.empty() || jobs <= 1) {
+            for (size_t k=0; k<jobs; k++) job(k);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = std::move(job);
+            jobs_ = jobs;
+            next_.store(0, std::memory_order_relaxed);
+            finished_ = 0;
+            batch_++;
+        }
+        wake_.notify_all();
+        drain();
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&]() { return finished_ == workers_; });
+    }
+
+    size_t size() const { return workers_ + 1; }
+
+    ~WorkerPool() { stop(); }
+}; // Fixed set of threads running batches of indexed jobs, the caller blocks until the batch is over